@@ -50,6 +50,9 @@
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
 
+/* Most sectors one READ or WRITE SECTOR command can transfer. */
+#define MAX_MULTIPLE 256
+
 /* An ATA device. */
 struct ata_disk
   {
@@ -86,6 +89,7 @@ static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
 static void select_sector (struct ata_disk *, block_sector_t);
+static void select_sectors (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -123,7 +127,7 @@ ide_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
+      lock_init_named (&c->lock, "ide channel");
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
  
@@ -376,10 +380,79 @@ ide_write (void *d_, block_sector_t sec_no, const void *buffer)
   lock_release (&c->lock);
 }
 
+/* Reads the CNT sectors starting at SEC_NO from disk D, sector
+   SEC_NO + I into BUFFERS[I], using one READ SECTORS command for
+   each run of up to MAX_MULTIPLE sectors.  The disk interrupts
+   once for each sector it has ready.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read_multiple (void *d_, block_sector_t sec_no,
+                   void *const buffers[], size_t cnt)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  size_t i, n;
+
+  lock_acquire (&c->lock);
+  for (; cnt > 0; sec_no += n, buffers += n, cnt -= n)
+    {
+      n = cnt < MAX_MULTIPLE ? cnt : MAX_MULTIPLE;
+      select_sectors (d, sec_no, n);
+      issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+      for (i = 0; i < n; i++)
+        {
+          sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                   d->name, sec_no + i);
+          input_sector (c, buffers[i]);
+        }
+    }
+  lock_release (&c->lock);
+}
+
+/* Writes the CNT sectors starting at SEC_NO to disk D, sector
+   SEC_NO + I from BUFFERS[I], using one WRITE SECTORS command for
+   each run of up to MAX_MULTIPLE sectors.  The disk interrupts
+   after each sector it has taken.  Returns after the disk has
+   acknowledged receiving all the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write_multiple (void *d_, block_sector_t sec_no,
+                    const void *const buffers[], size_t cnt)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  size_t i, n;
+
+  lock_acquire (&c->lock);
+  for (; cnt > 0; sec_no += n, buffers += n, cnt -= n)
+    {
+      n = cnt < MAX_MULTIPLE ? cnt : MAX_MULTIPLE;
+      select_sectors (d, sec_no, n);
+      issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+      for (i = 0; i < n; i++)
+        {
+          if (i > 0)
+            sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                   d->name, sec_no + i);
+          output_sector (c, buffers[i]);
+        }
+      sema_down (&c->completion_wait);
+    }
+  lock_release (&c->lock);
+}
+
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multiple,
+    ide_write_multiple
   };
 
 /* Selects device D, waiting for it to become ready, and then
@@ -387,13 +460,24 @@ static struct block_operations ide_operations =
    use LBA mode.) */
 static void
 select_sector (struct ata_disk *d, block_sector_t sec_no)
+{
+  select_sectors (d, sec_no, 1);
+}
+
+/* Selects device D, waiting for it to become ready, and then
+   writes SEC_NO and CNT to the disk's sector selection
+   registers, for a transfer of CNT sectors starting at SEC_NO.
+   CNT must be between 1 and MAX_MULTIPLE. */
+static void
+select_sectors (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt >= 1 && cnt <= MAX_MULTIPLE);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt == MAX_MULTIPLE ? 0 : cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -13,6 +13,9 @@
 #include "devices/block.h"
 #include "filesys/filesys.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#endif
 
 /* Keyboard control register port. */
 #define CONTROL_REG 0x64
@@ -130,8 +133,14 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  lock_print_stats ();
+  if (thread_sched_stats)
+    thread_print_sched_stats ();
 #ifdef FILESYS
   block_print_stats ();
+#endif
+#ifdef VM
+  frame_print_stats ();
 #endif
   console_print_stats ();
   kbd_print_stats ();
@@ -8,6 +8,7 @@
 #include <round.h>
 #include <stdio.h>
 #include "devices/pit.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
@@ -24,28 +25,67 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-int64_t next_wakeup_tick;
+/* Hierarchical timer wheel holding pending callouts.  Level L
+   has WHEEL_SLOTS slots, each covering WHEEL_SLOTS^L ticks, so a
+   callout due within WHEEL_SLOTS^(L+1) ticks of wheel_now sits in
+   level L and is cascaded one level down each time the level
+   below wraps around.  Arming and expiring are O(1) however many
+   callouts are pending.  Callouts further out than the top level
+   covers wait in its farthest slot and are re-filed when it
+   cascades. */
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4
+static struct list wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+static int64_t wheel_now;       /* Last tick the wheel processed. */
+static int wheel_pending;       /* # of callouts in the wheel. */
+
+/* Tickless idle.  If timer_tickless is true (kernel option
+   "-tickless"), the idle thread reprograms the PIT to fire once
+   at the next callout deadline instead of every tick, and the
+   ticks slept through are replayed when it wakes up.  An 8254
+   counter holds at most 65535 cycles, so one idle period spans
+   at most TICKLESS_MAX_TICKS ticks. */
+bool timer_tickless;
+#define TICK_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+#define TICKLESS_MAX_TICKS (65535 / TICK_CYCLES)
+static int tickless_span;       /* Ticks covered by armed one-shot, or 0. */
+static unsigned tickless_count; /* PIT cycles the one-shot was armed with. */
+static unsigned tickless_first; /* Cycles from arming to the first tick. */
+static long long tickless_skipped; /* # of timer interrupts avoided. */
 
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Number of time-stamp counter cycles per timer tick.
+   Initialized by timer_calibrate(). */
+static uint64_t cycles_per_tick;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+static void wheel_insert (struct timer_callout *);
+static void wheel_advance (int64_t now);
+static void wake_sleeper (void *t_);
+static int wheel_idle_span (int max);
+static void tickless_resume (int slept);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void
 timer_init (void) 
 {
+  int level, slot;
+
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 
-  list_init (&sleeping_list);
-  next_wakeup_tick = INT64_MAX;
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SLOTS; slot++)
+      list_init (&wheel[level][slot]);
 }
 
 
@@ -74,6 +114,30 @@ timer_calibrate (void)
       loops_per_tick |= test_bit;
 
   printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+  /* Measure the time-stamp counter across one full tick. */
+  {
+    int64_t start = timer_ticks ();
+    uint64_t tsc;
+
+    while (timer_ticks () == start)
+      barrier ();
+    tsc = cpu_cycles ();
+    start = timer_ticks ();
+    while (timer_ticks () == start)
+      barrier ();
+    cycles_per_tick = cpu_cycles () - tsc;
+  }
+}
+
+/* Converts CYCLES of the time-stamp counter to microseconds.
+   Returns 0 until timer_calibrate() has run. */
+uint64_t
+timer_cycles_to_us (uint64_t cycles)
+{
+  if (cycles_per_tick == 0)
+    return 0;
+  return cycles * (1000 * 1000 / TIMER_FREQ) / cycles_per_tick;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -99,10 +163,27 @@ timer_elapsed (int64_t then)
 void
 timer_sleep (int64_t ticks) 
 {
+  struct timer_callout wakeup;
+  enum intr_level old_level;
+
   if (ticks <= 0){return;}
   ASSERT(intr_get_level() == INTR_ON);
-  int64_t wakeup_tick = timer_ticks () + ticks;
-  thread_sleep (wakeup_tick);
+
+  timer_callout_init (&wakeup);
+  old_level = intr_disable ();
+  timer_callout_add (&wakeup, ticks, wake_sleeper, thread_current ());
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Callout function for timer_sleep(): unblocks thread T_. */
+static void
+wake_sleeper (void *t_)
+{
+  struct thread *t = t_;
+
+  thread_unblock (t);
+  if (MLFQS_DEBUG) DBG_MLFQS("WAKE: %s at tick=%'"PRId64"\n", t->name, ticks);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -173,47 +254,282 @@ void
 timer_print_stats (void) 
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  if (timer_tickless)
+    printf ("Timer: %lld ticks skipped while idle\n", tickless_skipped);
 }
-/* Timer interrupt handler. */
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  With tickless idle enabled, replaces the periodic tick
+   by a one-shot interrupt at the next tick that has work to do:
+   a callout expiring or a wheel cascade.  The one-shot is aligned
+   to the periodic tick boundaries so that the ticks replayed on
+   wakeup match real time. */
+void
+timer_idle_enter (void)
+{
+  int span;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!timer_tickless || tickless_span != 0 || TICKLESS_MAX_TICKS < 2)
+    return;
+
+  span = wheel_idle_span (TICKLESS_MAX_TICKS);
+  if (span < 2)
+    return;
+
+  tickless_first = pit_read_counter (0);
+  if (tickless_first == 0 || tickless_first > TICK_CYCLES)
+    tickless_first = TICK_CYCLES;
+  tickless_count = tickless_first + (span - 1) * TICK_CYCLES;
+  tickless_span = span;
+  pit_configure_oneshot (0, tickless_count);
+}
+
+/* Called by the idle thread after it wakes from halting.  If
+   something other than the one-shot timer woke it up, works out
+   from the PIT counter how many tick boundaries passed, replays
+   them and returns to periodic ticking. */
+void
+timer_idle_exit (void)
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (tickless_span != 0)
+    {
+      unsigned left = pit_read_counter (0);
+      int crossed;
+
+      if (left == 0 || left > tickless_count)
+        {
+          /* The one-shot already expired and its interrupt is
+             pending; let timer_interrupt() count the last tick. */
+          crossed = tickless_span - 1;
+        }
+      else
+        {
+          unsigned elapsed = tickless_count - left;
+          crossed = (elapsed < tickless_first ? 0
+                     : 1 + (elapsed - tickless_first) / TICK_CYCLES);
+        }
+      tickless_resume (crossed);
+    }
+
+  intr_set_level (old_level);
+}
+
+/* Restores periodic ticking after a tickless idle period and
+   replays the SLEPT ticks that passed without an interrupt: each
+   is charged to the idle thread, MLFQS per-second bookkeeping
+   runs at each second boundary, and expired callouts fire.
+   Interrupts must be off. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+tickless_resume (int slept)
 {
-  ticks++;
-  thread_tick ();
-  if (ticks >= next_wakeup_tick){
-    struct list_elem *e;
-    struct thread *t;
-
-    while (!list_empty (&sleeping_list)){
-      e = list_begin (&sleeping_list);
-      t = list_entry (e, struct thread, sleepelem);
-
-      if (ticks >= t->wakeup_tick){
-        list_remove (e);
-        thread_unblock (t);
-        if (MLFQS_DEBUG) DBG_MLFQS("WAKE: %s at tick=%'"PRId64"\n", t->name, ticks);
-      }
-      else {break;}
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  pit_configure_channel (0, 2, TIMER_FREQ);
+  tickless_span = 0;
+  tickless_skipped += slept;
+
+  thread_account_idle_ticks (slept);
+  while (slept-- > 0)
+    {
+      ticks++;
+      if (thread_mlfqs && ticks % TIMER_FREQ == 0)
+        thread_tick_one_second_mlfqs ();
     }
-    
-    if (!list_empty (&sleeping_list)){
-      t = list_entry (list_begin (&sleeping_list), struct thread, sleepelem);
-      next_wakeup_tick = t->wakeup_tick;
+  wheel_advance (ticks);
+}
+/* Initializes callout C so that it is not pending. */
+void
+timer_callout_init (struct timer_callout *c)
+{
+  ASSERT (c != NULL);
+
+  c->pending = false;
+  c->func = NULL;
+  c->aux = NULL;
+}
+
+/* Arranges for FUNC(AUX) to be called from the timer interrupt
+   DELAY timer ticks from now (at the next tick if DELAY <= 0),
+   using C as storage.  C must not already be pending.  FUNC runs
+   in an external interrupt context, so it must not sleep; it may
+   re-add C to run periodically.
+
+   This function may be called from an interrupt handler. */
+void
+timer_callout_add (struct timer_callout *c, int64_t delay,
+                   timer_callout_func *func, void *aux)
+{
+  enum intr_level old_level;
+
+  ASSERT (c != NULL);
+  ASSERT (func != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (!c->pending);
+  c->expires = ticks + (delay > 0 ? delay : 1);
+  c->func = func;
+  c->aux = aux;
+  c->pending = true;
+  wheel_pending++;
+  wheel_insert (c);
+  intr_set_level (old_level);
+}
+
+/* Cancels callout C.  Returns true if it was still pending,
+   false if it had already run or was never added.
+
+   This function may be called from an interrupt handler. */
+bool
+timer_callout_cancel (struct timer_callout *c)
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT (c != NULL);
+
+  old_level = intr_disable ();
+  was_pending = c->pending;
+  if (was_pending)
+    {
+      list_remove (&c->elem);
+      c->pending = false;
+      wheel_pending--;
     }
+  intr_set_level (old_level);
+
+  return was_pending;
+}
+
+/* Files pending callout C into the wheel slot for its expiry
+   relative to wheel_now.  While wheel_advance() is cascading,
+   slot wheel_now of level 0 has not been run yet, so a callout
+   due now still fires on this tick.  Interrupts must be off. */
+static void
+wheel_insert (struct timer_callout *c)
+{
+  int64_t expires = c->expires;
+  int64_t delta;
+  int level;
+
+  if (expires < wheel_now)
+    expires = wheel_now;
+  delta = expires - wheel_now;
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < (int64_t) 1 << (WHEEL_BITS * (level + 1)))
+      break;
+  if (delta >= (int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))
+    expires = wheel_now + ((int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+
+  list_push_back (&wheel[level][(expires >> (WHEEL_BITS * level))
+                                & (WHEEL_SLOTS - 1)],
+                  &c->elem);
+}
+
+/* Moves every callout in slot SLOT of LEVEL back through
+   wheel_insert(), which files it one or more levels lower. */
+static void
+wheel_cascade (int level, int slot)
+{
+  struct list *bucket = &wheel[level][slot];
+  struct list moving;
+
+  list_init (&moving);
+  while (!list_empty (bucket))
+    list_push_back (&moving, list_pop_front (bucket));
+  while (!list_empty (&moving))
+    wheel_insert (list_entry (list_pop_front (&moving),
+                              struct timer_callout, elem));
+}
 
-    else {
-      next_wakeup_tick = INT64_MAX; 
+/* Runs the wheel forward to tick NOW, calling every callout that
+   expires on the way.  Interrupts must be off. */
+static void
+wheel_advance (int64_t now)
+{
+  /* Nothing to fire or cascade: jump straight to NOW. */
+  if (wheel_pending == 0)
+    {
+      wheel_now = now;
+      return;
     }
-  }
+
+  while (wheel_now < now)
+    {
+      struct list *bucket;
+      int slot, level;
+
+      wheel_now++;
+      slot = wheel_now & (WHEEL_SLOTS - 1);
+
+      /* Each time a level wraps to slot 0, pull the next slot of
+         the level above down into the wheel. */
+      for (level = 1; level < WHEEL_LEVELS; level++)
+        {
+          int idx = (wheel_now >> (WHEEL_BITS * (level - 1)))
+                    & (WHEEL_SLOTS - 1);
+          if (idx != 0)
+            break;
+          wheel_cascade (level, (wheel_now >> (WHEEL_BITS * level))
+                                & (WHEEL_SLOTS - 1));
+        }
+
+      bucket = &wheel[0][slot];
+      while (!list_empty (bucket))
+        {
+          struct timer_callout *c = list_entry (list_pop_front (bucket),
+                                                struct timer_callout, elem);
+          c->pending = false;
+          wheel_pending--;
+          c->func (c->aux);
+        }
+    }
+}
+
+/* Returns how many ticks, from 1 up to MAX, can pass before the
+   wheel next has work to do: the first non-empty level-0 slot or
+   the next cascade.  Interrupts must be off. */
+static int
+wheel_idle_span (int max)
+{
+  int span;
+
+  for (span = 1; span < max; span++)
+    {
+      int64_t t = wheel_now + span;
+
+      if (!list_empty (&wheel[0][t & (WHEEL_SLOTS - 1)]))
+        break;
+      if ((t & (WHEEL_SLOTS - 1)) == 0 && wheel_pending > 0)
+        break;
+    }
+  return span;
+}
+
+/* Timer interrupt handler. */
+static void
+timer_interrupt (struct intr_frame *args UNUSED)
+{
+  /* A tickless one-shot expired: catch up on the ticks it
+     covered, all but this one. */
+  if (tickless_span != 0)
+    tickless_resume (tickless_span - 1);
+
+  ticks++;
+  thread_tick ();
+  wheel_advance (ticks);
 
     if (thread_mlfqs && ticks % TIMER_FREQ == 0) {
-        mlfqs_update_load_avg_and_recent_cpu_all();  // updates all threads' recent_cpu, load_avg
-        mlfqs_recompute_priority_all();              // recompute priorities for ALL threads (O(n))
+        thread_tick_one_second_mlfqs();  // load_avg and this second's decay; threads catch up lazily
 
     if (MLFQS_DEBUG) {
       int la100 = FP_ROUND(FP_MULT_MIX(load_avg, 100));
       DBG_MLFQS("[1s] ready=%d load_avg=%d.%02d @ tick=%'"PRId64"\n",
-                (int)list_size(&ready_list) + (thread_current()!=idle_thread ? 1 : 0),
+                thread_ready_count() + (thread_current()!=idle_thread ? 1 : 0),
                 la100/100, la100%100, ticks);
     }
     
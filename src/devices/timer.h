@@ -1,7 +1,9 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* Number of timer interrupts per second. */
@@ -26,6 +28,30 @@ void timer_ndelay (int64_t nanoseconds);
 
 void timer_print_stats (void);
 
-extern int64_t next_wakeup_tick;
+uint64_t timer_cycles_to_us (uint64_t cycles);
+
+/* Tickless idle, enabled by kernel option "-tickless". */
+extern bool timer_tickless;
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
+/* Callouts: deferred calls made from the timer interrupt. */
+typedef void timer_callout_func (void *aux);
+
+/* A pending callout.  Storage belongs to the caller and must
+   stay valid until the callout runs or is cancelled. */
+struct timer_callout
+  {
+    int64_t expires;            /* Tick at which to run. */
+    timer_callout_func *func;   /* Function to call. */
+    void *aux;                  /* Argument for FUNC. */
+    bool pending;               /* Queued in the timer wheel? */
+    struct list_elem elem;      /* Timer wheel slot element. */
+  };
+
+void timer_callout_init (struct timer_callout *);
+void timer_callout_add (struct timer_callout *, int64_t ticks,
+                        timer_callout_func *, void *aux);
+bool timer_callout_cancel (struct timer_callout *);
 
 #endif /* devices/timer.h */
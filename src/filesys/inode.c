@@ -5,7 +5,9 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
@@ -33,7 +35,8 @@ struct inode
   {
     struct list_elem elem;              /* Element in inode list. */
     block_sector_t sector;              /* Sector number of disk location. */
-    int open_cnt;                       /* Number of openers. */
+    int open_cnt;                       /* Number of openers, under
+                                           open_inodes_lock. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
     struct inode_disk data;             /* Inode content. */
@@ -57,11 +60,20 @@ byte_to_sector (const struct inode *inode, off_t pos)
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/* Protects open_inodes.  Opening an inode that is already open
+   only needs to read the list, so concurrent opens of open files
+   do not serialize. */
+static struct rwlock open_inodes_lock;
+
+static struct inode *inode_lookup (block_sector_t sector);
+static struct inode *inode_get (struct inode *inode);
+
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  rwlock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -111,25 +123,32 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
   struct inode *inode;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  rwlock_acquire_read (&open_inodes_lock);
+  inode = inode_lookup (sector);
+  rwlock_release_read (&open_inodes_lock);
+  if (inode != NULL)
+    return inode;
+
+  /* Check again under the write lock, since another thread may
+     have opened it in the meantime. */
+  rwlock_acquire_write (&open_inodes_lock);
+  inode = inode_lookup (sector);
+  if (inode != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
+      rwlock_release_write (&open_inodes_lock);
+      return inode;
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      rwlock_release_write (&open_inodes_lock);
+      return NULL;
+    }
 
   /* Initialize. */
   list_push_front (&open_inodes, &inode->elem);
@@ -138,15 +157,52 @@ inode_open (block_sector_t sector)
   inode->deny_write_cnt = 0;
   inode->removed = false;
   block_read (fs_device, inode->sector, &inode->data);
+  rwlock_release_write (&open_inodes_lock);
   return inode;
 }
 
+/* Returns the open inode for SECTOR, reopened, or a null pointer
+   if it is not open.  The caller must hold open_inodes_lock,
+   for reading or writing. */
+static struct inode *
+inode_lookup (block_sector_t sector)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e)) 
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      if (inode->sector == sector) 
+        return inode_get (inode);
+    }
+  return NULL;
+}
+
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      rwlock_acquire_read (&open_inodes_lock);
+      inode_get (inode);
+      rwlock_release_read (&open_inodes_lock);
+    }
+  return inode;
+}
+
+/* Adds an opener to INODE and returns it.  The caller must hold
+   open_inodes_lock, which keeps inode_close() from changing
+   open_cnt meanwhile.  Holders of the lock for reading may get the
+   same inode at once, so the increment is made with interrupts
+   off. */
+static struct inode *
+inode_get (struct inode *inode)
+{
+  enum intr_level old_level = intr_disable ();
+  inode->open_cnt++;
+  intr_set_level (old_level);
   return inode;
 }
 
@@ -168,10 +224,12 @@ inode_close (struct inode *inode)
     return;
 
   /* Release resources if this was the last opener. */
+  rwlock_acquire_write (&open_inodes_lock);
   if (--inode->open_cnt == 0)
     {
       /* Remove from inode list and release lock. */
       list_remove (&inode->elem);
+      rwlock_release_write (&open_inodes_lock);
  
       /* Deallocate blocks if removed. */
       if (inode->removed) 
@@ -183,6 +241,8 @@ inode_close (struct inode *inode)
 
       free (inode); 
     }
+  else
+    rwlock_release_write (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
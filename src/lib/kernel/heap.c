@@ -0,0 +1,184 @@
+/* Pairing heap.
+
+   See heap.h for basic information. */
+
+#include "heap.h"
+#include "../debug.h"
+
+static struct heap_elem *meld (struct heap *,
+                               struct heap_elem *, struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+
+/* Initializes heap H as empty, to compare elements using LESS
+   given auxiliary data AUX. */
+void
+heap_init (struct heap *h, heap_less_func *less, void *aux) 
+{
+  ASSERT (h != NULL);
+  ASSERT (less != NULL);
+
+  h->root = NULL;
+  h->elem_cnt = 0;
+  h->less = less;
+  h->aux = aux;
+}
+
+/* Inserts E into H.  E must not already be in a heap. */
+void
+heap_insert (struct heap *h, struct heap_elem *e) 
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  e->child = e->next = e->prev = NULL;
+  h->root = meld (h, h->root, e);
+  h->elem_cnt++;
+}
+
+/* Returns the maximum element in H, or a null pointer if H is
+   empty. */
+struct heap_elem *
+heap_max (const struct heap *h) 
+{
+  ASSERT (h != NULL);
+
+  return h->root;
+}
+
+/* Removes and returns the maximum element in H, which must not
+   be empty. */
+struct heap_elem *
+heap_pop_max (struct heap *h) 
+{
+  struct heap_elem *max;
+
+  ASSERT (h != NULL);
+  ASSERT (!heap_empty (h));
+
+  max = h->root;
+  h->root = merge_pairs (h, max->child);
+  h->elem_cnt--;
+
+  max->child = NULL;
+  return max;
+}
+
+/* Removes E, which must be in H, from H. */
+void
+heap_remove (struct heap *h, struct heap_elem *e) 
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+  ASSERT (!heap_empty (h));
+
+  if (e == h->root) 
+    {
+      heap_pop_max (h);
+      return;
+    }
+
+  /* Unlink E and its subtree from its parent or left sibling. */
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+
+  /* Put E's children back. */
+  h->root = meld (h, h->root, merge_pairs (h, e->child));
+  h->elem_cnt--;
+
+  e->child = e->next = e->prev = NULL;
+}
+
+/* Restores the heap order of H after the value of E, which must
+   be in H, has changed. */
+void
+heap_update (struct heap *h, struct heap_elem *e) 
+{
+  heap_remove (h, e);
+  heap_insert (h, e);
+}
+
+/* Returns the number of elements in H. */
+size_t
+heap_size (const struct heap *h) 
+{
+  return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+heap_empty (const struct heap *h) 
+{
+  return h->root == NULL;
+}
+
+/* Joins the trees rooted at A and B, either of which may be
+   null, into one tree and returns its root.  The smaller root
+   becomes the first child of the larger one.  A and B must have
+   no siblings. */
+static struct heap_elem *
+meld (struct heap *h, struct heap_elem *a, struct heap_elem *b) 
+{
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+
+  if (h->less (a, b, h->aux)) 
+    {
+      struct heap_elem *t = a;
+      a = b;
+      b = t;
+    }
+
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  a->next = a->prev = NULL;
+  return a;
+}
+
+/* Melds the sibling list that starts at FIRST into a single
+   tree and returns its root.  Siblings are first melded in
+   pairs from left to right, then the pairs are melded from
+   right to left, which is what gives the pairing heap its
+   logarithmic amortized bound. */
+static struct heap_elem *
+merge_pairs (struct heap *h, struct heap_elem *first) 
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *root = NULL;
+
+  /* First pass: meld adjacent pairs, stacking the results on
+     PAIRS so that the rightmost pair ends up on top. */
+  while (first != NULL) 
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+
+      first = b != NULL ? b->next : NULL;
+      a->next = a->prev = NULL;
+      if (b != NULL)
+        b->next = b->prev = NULL;
+
+      a = meld (h, a, b);
+      a->next = pairs;
+      pairs = a;
+    }
+
+  /* Second pass: meld the pairs from right to left. */
+  while (pairs != NULL) 
+    {
+      struct heap_elem *next = pairs->next;
+
+      pairs->next = NULL;
+      root = meld (h, root, pairs);
+      pairs = next;
+    }
+  return root;
+}
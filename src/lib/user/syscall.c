@@ -188,3 +188,27 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+pid_t
+fork (void)
+{
+  return syscall0 (SYS_FORK);
+}
+
+int
+madvise (void *addr, unsigned length, int advice)
+{
+  return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+int
+mlock (void *addr, unsigned length)
+{
+  return syscall2 (SYS_MLOCK, addr, length);
+}
+
+int
+munlock (void *addr, unsigned length)
+{
+  return syscall2 (SYS_MUNLOCK, addr, length);
+}
@@ -15,6 +15,13 @@ typedef int mapid_t;
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* Advice for madvise(). */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Expect accesses in no order. */
+#define MADV_SEQUENTIAL 2       /* Expect accesses in order, once. */
+#define MADV_WILLNEED 3         /* Expect access soon. */
+#define MADV_DONTNEED 4         /* Do not expect access; drop the pages. */
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
@@ -45,4 +52,10 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+pid_t fork (void);
+int madvise (void *addr, unsigned length, int advice);
+int mlock (void *addr, unsigned length);
+int munlock (void *addr, unsigned length);
+
 #endif /* lib/user/syscall.h */
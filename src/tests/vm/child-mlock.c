@@ -0,0 +1,23 @@
+/* Child process of mlock-exit.
+   Locks 64 pages, as many as a process may by default, writes
+   them, and exits without unlocking them. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+const char *test_name = "child-mlock";
+
+#define PAGE_SIZE 4096
+#define PAGE_CNT 64
+
+static char buf[PAGE_CNT * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+int
+main (void)
+{
+  if (mlock (buf, sizeof buf) != 0)
+    fail ("mlock %d pages", PAGE_CNT);
+  memset (buf, 0x5a, sizeof buf);
+  return 0x42;
+}
@@ -0,0 +1,58 @@
+/* Forks a child that checks that it sees the parent's memory,
+   then has parent and child each overwrite their copy and
+   verifies that neither sees the other's writes.  Also checks
+   that fork() returns 0 in the child and the child's pid, as
+   accepted by wait(), in the parent. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (64 * 1024)
+
+static char buf[SIZE];
+
+/* Fails unless every byte of buf is VALUE. */
+static void
+check_buf (char value, const char *who)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    if (buf[i] != value)
+      fail ("%s: byte %zu is 0x%02x, not 0x%02x",
+            who, i, buf[i] & 0xff, value & 0xff);
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+
+  msg ("initialize");
+  memset (buf, 0x5a, sizeof buf);
+
+  child = fork ();
+  if (child == 0)
+    {
+      /* The parent may or may not have overwritten its copy yet;
+         either way ours must still hold the old contents. */
+      check_buf (0x5a, "child");
+      msg ("child sees parent's memory");
+      memset (buf, 0xc3, sizeof buf);
+      check_buf (0xc3, "child");
+      msg ("child wrote its copy");
+      exit (81);
+    }
+  if (child == -1)
+    fail ("fork failed");
+
+  /* Write before waiting, so that the child could see it if the
+     copies were not private.  Nothing is printed until the child
+     is done, to keep the output in order. */
+  memset (buf, 0xa5, sizeof buf);
+  CHECK (wait (child) == 81, "wait for child");
+  check_buf (0xa5, "parent");
+  msg ("parent's copy is private");
+}
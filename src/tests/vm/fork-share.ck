@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-share) begin
+(fork-share) initialize
+(fork-share) child sees parent's memory
+(fork-share) child wrote its copy
+(fork-share) wait for child
+(fork-share) parent's copy is private
+(fork-share) end
+EOF
+pass;
@@ -0,0 +1,63 @@
+/* Fills 1 MB of memory with pseudo-random data and forks.  The
+   child then writes 2 MB of other memory, which pushes the pages
+   it shares with the parent out to swap, and checks that they
+   read back intact.  The parent checks its copy after the child
+   exits. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (1024 * 1024)
+#define PRESSURE_SIZE (2 * 1024 * 1024)
+#define CHUNK_SIZE 4096
+
+static char buf[SIZE];
+static char pressure[PRESSURE_SIZE];
+
+/* Fails unless buf holds the key stream that fill() put there. */
+static void
+verify (const char *who)
+{
+  static char expected[CHUNK_SIZE];
+  struct arc4 arc4;
+  size_t ofs;
+
+  arc4_init (&arc4, "foobar", 6);
+  for (ofs = 0; ofs < SIZE; ofs += CHUNK_SIZE)
+    {
+      memset (expected, 0, sizeof expected);
+      arc4_crypt (&arc4, expected, sizeof expected);
+      if (memcmp (buf + ofs, expected, sizeof expected))
+        fail ("%s: bad data in page at offset %zu", who, ofs);
+    }
+}
+
+void
+test_main (void)
+{
+  struct arc4 arc4;
+  pid_t child;
+
+  msg ("fill");
+  arc4_init (&arc4, "foobar", 6);
+  arc4_crypt (&arc4, buf, SIZE);
+
+  child = fork ();
+  if (child == 0)
+    {
+      msg ("child: apply memory pressure");
+      memset (pressure, 0x5a, sizeof pressure);
+      msg ("child: verify");
+      verify ("child");
+      exit (82);
+    }
+  if (child == -1)
+    fail ("fork failed");
+
+  CHECK (wait (child) == 82, "wait for child");
+  msg ("parent: verify");
+  verify ("parent");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fork-swap) begin
+(fork-swap) fill
+(fork-swap) child: apply memory pressure
+(fork-swap) child: verify
+(fork-swap) wait for child
+(fork-swap) parent: verify
+(fork-swap) end
+EOF
+pass;
@@ -0,0 +1,38 @@
+/* Checks that madvise() fails on a range that runs into
+   unmapped memory, and that MADV_DONTNEED fails on a page locked
+   by mlock() and leaves its contents alone. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define ACTUAL ((char *) 0x10000000)
+
+static char locked[PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+  size_t i;
+  int handle;
+
+  CHECK (madvise (ACTUAL, PAGE_SIZE, MADV_NORMAL) == -1,
+         "madvise unmapped page");
+
+  /* The file is one page long, so the second page is unmapped. */
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (handle, ACTUAL) != MAP_FAILED, "mmap \"sample.txt\"");
+  CHECK (madvise (ACTUAL, 2 * PAGE_SIZE, MADV_RANDOM) == -1,
+         "madvise range past end of mapping");
+
+  memset (locked, 0x5a, sizeof locked);
+  CHECK (mlock (locked, sizeof locked) == 0, "mlock page");
+  CHECK (madvise (locked, sizeof locked, MADV_DONTNEED) == -1,
+         "madvise locked page");
+  for (i = 0; i < sizeof locked; i++)
+    if (locked[i] != 0x5a)
+      fail ("locked page lost its contents at byte %zu", i);
+  msg ("locked page kept its contents");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madv-bad) begin
+(madv-bad) madvise unmapped page
+(madv-bad) open "sample.txt"
+(madv-bad) mmap "sample.txt"
+(madv-bad) madvise range past end of mapping
+(madv-bad) mlock page
+(madv-bad) madvise locked page
+(madv-bad) locked page kept its contents
+(madv-bad) end
+EOF
+pass;
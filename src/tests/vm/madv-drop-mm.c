@@ -0,0 +1,35 @@
+/* Checks that madvise() with MADV_DONTNEED writes a dirty page
+   of a memory-mapped file back to the file before dropping it,
+   so that both the file and the mapping then hold the new
+   data. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/vm/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+
+void
+test_main (void)
+{
+  static const char overwrite[] = "Now is the time for all good...";
+  char buf[sizeof overwrite];
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (handle, ACTUAL) != MAP_FAILED, "mmap \"sample.txt\"");
+  memcpy (ACTUAL, overwrite, strlen (overwrite));
+  CHECK (madvise (ACTUAL, 4096, MADV_DONTNEED) == 0, "madvise mapping");
+
+  CHECK (read (handle, buf, strlen (overwrite)) == (int) strlen (overwrite),
+         "read \"sample.txt\"");
+  if (memcmp (buf, overwrite, strlen (overwrite)))
+    fail ("madvise did not write back dirty page");
+  if (memcmp (ACTUAL, overwrite, strlen (overwrite))
+      || memcmp (ACTUAL + strlen (overwrite), sample + strlen (overwrite),
+                 strlen (sample) - strlen (overwrite)))
+    fail ("mapping does not read back from the file");
+  msg ("file and mapping hold the new data");
+}
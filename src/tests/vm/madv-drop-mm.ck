@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madv-drop-mm) begin
+(madv-drop-mm) open "sample.txt"
+(madv-drop-mm) mmap "sample.txt"
+(madv-drop-mm) madvise mapping
+(madv-drop-mm) read "sample.txt"
+(madv-drop-mm) file and mapping hold the new data
+(madv-drop-mm) end
+EOF
+pass;
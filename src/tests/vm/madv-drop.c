@@ -0,0 +1,57 @@
+/* Checks that madvise() with MADV_DONTNEED drops the contents of
+   a page: an anonymous page reads back as zeros, even after it
+   was pushed out to swap, and a page of the executable's data
+   reads back as it is in the executable. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define PRESSURE_SIZE (2 * 1024 * 1024)
+
+static const char initial[] = "contents from the executable";
+
+static char anon[PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+static char data[PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)))
+  = "contents from the executable";
+static char pressure[PRESSURE_SIZE];
+
+/* Fails unless the SIZE bytes at BUF are all zero. */
+static void
+check_zero (const char *buf, size_t size, const char *name)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (buf[i] != 0)
+      fail ("%s: byte %zu is 0x%02x, not zero", name, i, buf[i] & 0xff);
+}
+
+void
+test_main (void)
+{
+  memset (anon, 0x5a, sizeof anon);
+  CHECK (madvise (anon, sizeof anon, MADV_DONTNEED) == 0,
+         "madvise anonymous page");
+  check_zero (anon, sizeof anon, "anonymous page");
+  msg ("anonymous page reads back as zeros");
+
+  memset (anon, 0xa5, sizeof anon);
+  msg ("push it out to swap");
+  memset (pressure, 0x5a, sizeof pressure);
+  CHECK (madvise (anon, sizeof anon, MADV_DONTNEED) == 0,
+         "madvise swapped page");
+  check_zero (anon, sizeof anon, "swapped page");
+  msg ("swapped page reads back as zeros");
+
+  memset (data, 0xa5, sizeof data);
+  CHECK (madvise (data, sizeof data, MADV_DONTNEED) == 0,
+         "madvise data page");
+  if (memcmp (data, initial, sizeof initial))
+    fail ("data page does not read back from the executable");
+  check_zero (data + sizeof initial, sizeof data - sizeof initial,
+              "data page");
+  msg ("data page reads back from the executable");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madv-drop) begin
+(madv-drop) madvise anonymous page
+(madv-drop) anonymous page reads back as zeros
+(madv-drop) push it out to swap
+(madv-drop) madvise swapped page
+(madv-drop) swapped page reads back as zeros
+(madv-drop) madvise data page
+(madv-drop) data page reads back from the executable
+(madv-drop) end
+EOF
+pass;
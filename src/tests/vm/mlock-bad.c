@@ -0,0 +1,26 @@
+/* Checks that mlock() fails on a range that runs into unmapped
+   memory, and that it then locks none of the range.  A locked
+   page would make madvise() with MADV_DONTNEED fail. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define ACTUAL ((char *) 0x10000000)
+
+void
+test_main (void)
+{
+  int handle;
+
+  CHECK (mlock (ACTUAL, PAGE_SIZE) == -1, "mlock unmapped page");
+
+  /* The file is one page long, so the second page is unmapped. */
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (handle, ACTUAL) != MAP_FAILED, "mmap \"sample.txt\"");
+  CHECK (mlock (ACTUAL, 2 * PAGE_SIZE) == -1,
+         "mlock range past end of mapping");
+  CHECK (madvise (ACTUAL, PAGE_SIZE, MADV_DONTNEED) == 0,
+         "first page is not locked");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mlock-bad) begin
+(mlock-bad) mlock unmapped page
+(mlock-bad) open "sample.txt"
+(mlock-bad) mmap "sample.txt"
+(mlock-bad) mlock range past end of mapping
+(mlock-bad) first page is not locked
+(mlock-bad) end
+EOF
+pass;
@@ -0,0 +1,24 @@
+/* Runs child-mlock processes one after another.  Each locks 64
+   pages and exits without unlocking them, so together they lock
+   more frames than the kernel lets all processes hold at once
+   unless exit releases their locks. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 8
+
+void
+test_main (void)
+{
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid_t child;
+
+      CHECK ((child = exec ("child-mlock")) != -1, "exec \"child-mlock\"");
+      CHECK (wait (child) == 0x42, "wait for child %d", i);
+    }
+}
@@ -0,0 +1,38 @@
+/* Checks the per-process limit on locked pages, which the test
+   runs with at 4 pages: locking goes up to the limit and no
+   further, relocking a locked page is free, and munlock() and
+   munmap() both give pages back to the limit. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_SIZE 4096
+#define LIMIT 4
+#define ACTUAL ((char *) 0x10000000)
+
+static char buf[(LIMIT + 1) * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+  char *extra = buf + LIMIT * PAGE_SIZE;
+  mapid_t map;
+  int handle;
+
+  CHECK (mlock (buf, LIMIT * PAGE_SIZE) == 0, "mlock %d pages", LIMIT);
+  CHECK (mlock (buf, LIMIT * PAGE_SIZE) == 0, "mlock them again");
+  CHECK (mlock (extra, PAGE_SIZE) == -1, "mlock one more page");
+
+  CHECK (munlock (buf, PAGE_SIZE) == 0, "munlock one page");
+  CHECK (mlock (extra, PAGE_SIZE) == 0, "mlock one more page");
+  CHECK (munlock (extra, PAGE_SIZE) == 0, "munlock it");
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"sample.txt\"");
+  CHECK (mlock (ACTUAL, PAGE_SIZE) == 0, "mlock mapping");
+  CHECK (mlock (extra, PAGE_SIZE) == -1, "mlock one more page");
+  msg ("munmap \"sample.txt\"");
+  munmap (map);
+  CHECK (mlock (extra, PAGE_SIZE) == 0, "mlock one more page");
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mlock-limit) begin
+(mlock-limit) mlock 4 pages
+(mlock-limit) mlock them again
+(mlock-limit) mlock one more page
+(mlock-limit) munlock one page
+(mlock-limit) mlock one more page
+(mlock-limit) munlock it
+(mlock-limit) open "sample.txt"
+(mlock-limit) mmap "sample.txt"
+(mlock-limit) mlock mapping
+(mlock-limit) mlock one more page
+(mlock-limit) munmap "sample.txt"
+(mlock-limit) mlock one more page
+(mlock-limit) end
+EOF
+pass;
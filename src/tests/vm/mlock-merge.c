@@ -0,0 +1,37 @@
+/* Locks 16 pages of pseudo-random data in memory, then runs the
+   page-merge-par workload to put memory under pressure, and
+   checks that the locked pages kept their contents. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/parallel-merge.h"
+
+#define PAGE_SIZE 4096
+#define LOCKED_SIZE (16 * PAGE_SIZE)
+
+static char locked[LOCKED_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+
+void
+test_main (void)
+{
+  struct arc4 arc4;
+  size_t i;
+
+  arc4_init (&arc4, "mlock", 5);
+  arc4_crypt (&arc4, locked, sizeof locked);
+  CHECK (mlock (locked, sizeof locked) == 0, "mlock");
+
+  parallel_merge ("child-sort", 123);
+
+  /* Decrypting gives back the zeros we started from. */
+  msg ("verify locked pages");
+  arc4_init (&arc4, "mlock", 5);
+  arc4_crypt (&arc4, locked, sizeof locked);
+  for (i = 0; i < sizeof locked; i++)
+    if (locked[i] != 0)
+      fail ("locked pages lost their contents at byte %zu", i);
+  CHECK (munlock (locked, sizeof locked) == 0, "munlock");
+}
@@ -0,0 +1,32 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(mlock-merge) begin
+(mlock-merge) mlock
+(mlock-merge) init
+(mlock-merge) sort chunk 0
+(mlock-merge) sort chunk 1
+(mlock-merge) sort chunk 2
+(mlock-merge) sort chunk 3
+(mlock-merge) sort chunk 4
+(mlock-merge) sort chunk 5
+(mlock-merge) sort chunk 6
+(mlock-merge) sort chunk 7
+(mlock-merge) wait for child 0
+(mlock-merge) wait for child 1
+(mlock-merge) wait for child 2
+(mlock-merge) wait for child 3
+(mlock-merge) wait for child 4
+(mlock-merge) wait for child 5
+(mlock-merge) wait for child 6
+(mlock-merge) wait for child 7
+(mlock-merge) merge
+(mlock-merge) verify
+(mlock-merge) success, buf_idx=1,048,576
+(mlock-merge) verify locked pages
+(mlock-merge) munlock
+(mlock-merge) end
+EOF
+pass;
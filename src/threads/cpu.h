@@ -0,0 +1,16 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdint.h>
+
+/* Returns the time-stamp counter of the running CPU, which
+   counts processor cycles since reset. */
+static inline uint64_t
+cpu_cycles (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+#endif /* threads/cpu.h */
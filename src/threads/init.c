@@ -41,7 +41,10 @@
 /* ADD THIS FOR LAB 3 */
 #ifdef VM
 #include "vm/frame.h"
+#include "vm/page.h"
 #include "vm/swap.h"
+#include "vm/trace.h"
+#include "vm/zswap.h"
 #endif
 
 /* Page directory with kernel mappings only. */
@@ -327,12 +330,28 @@ parse_options (char **argv)
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-vmpolicy"))
+        frame_policy_name = value;
+      else if (!strcmp (name, "-vmtrace"))
+        vmtrace_enabled = true;
+      else if (!strcmp (name, "-zswap"))
+        zswap_pool_pages = atoi (value);
+      else if (!strcmp (name, "-mlock"))
+        spt_mlock_limit = atoi (value);
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-schedstat"))
+        thread_sched_stats = true;
+      else if (!strcmp (name, "-lockstat"))
+        lock_stats = true;
+      else if (!strcmp (name, "-tc"))
+        thread_cache_prealloc = atoi (value);
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -452,10 +471,21 @@ usage (void)
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -vmpolicy=NAME     Use page replacement policy NAME: clock\n"
+          "                     (default), clock2, 2q, or lru.\n"
+          "  -vmtrace           Trace page references to the scratch disk.\n"
+          "  -zswap=PAGES       Keep swapped pages compressed in a pool of\n"
+          "                     PAGES kernel pages, in front of swap.\n"
+          "  -mlock=PAGES       Let each process lock at most PAGES pages\n"
+          "                     in memory (default 64).\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Stop the periodic timer tick while idle.\n"
+          "  -tc=N              Preallocate N pages for new threads.\n"
+          "  -lockstat          Profile lock contention; print at shutdown.\n"
+          "  -schedstat         Print scheduler latency stats at shutdown.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
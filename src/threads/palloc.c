@@ -164,11 +164,21 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
+  lock_init_named (&p->lock, name);
   p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
   p->base = base + bm_pages * PGSIZE;
 }
 
+/* Returns the number of pages in the user pool and stores the
+   address of its first page in *BASE.  Every page that
+   palloc_get_page(PAL_USER) returns lies in that range. */
+size_t
+palloc_user_pages (void **base) 
+{
+  *base = user_pool.base;
+  return bitmap_size (user_pool.used_map);
+}
+
 /* Returns true if PAGE was allocated from POOL,
    false otherwise. */
 static bool
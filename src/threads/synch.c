@@ -31,44 +31,64 @@
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
 
 
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //Have to move this here to use it for the semaphore comparison
-/* One semaphore in a list. */
+/* One semaphore in a condition's waiters. */
 struct semaphore_elem 
   {
-    struct list_elem elem;              /* List element. */
+    struct heap_elem elem;              /* Heap element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
+    unsigned seq;                       /* Order of arrival. */
   };
 
+/* Arrival counter for waiters, so that waiters of equal priority
+   are woken first-come first-served. */
+static unsigned wait_seq;
+
+/* Returns true if waiter A should be woken after waiter B: A has
+   lower priority, or equal priority and arrived later. */
+static bool
+waiter_less (const struct thread *a, unsigned a_seq,
+             const struct thread *b, unsigned b_seq)
+{
+  if (a->priority != b->priority)
+    return a->priority < b->priority;
+  return (int) (a_seq - b_seq) > 0;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /* Implement priority here too, taken from thread.c*/
-static bool thread_priority_comparison(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED){
-   struct thread *threadA = list_entry(a, struct thread, elem);
-   struct thread *threadB = list_entry(b, struct thread, elem);
+static bool thread_priority_comparison(const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED){
+   struct thread *threadA = heap_entry(a, struct thread, wait_elem);
+   struct thread *threadB = heap_entry(b, struct thread, wait_elem);
 
-   return ((threadA->priority) > (threadB->priority));
+   return waiter_less(threadA, threadA->wait_seq, threadB, threadB->wait_seq);
 }
 
 /* Implement comparison for semaphores too */
 
-static bool thread_semaphore_comparison(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED){
-   // Setting up the two semaphore for comp.
-   //list_entry (list_pop_front (&sema->waiters), struct thread, elem)
-   struct semaphore_elem *semaphore_a = list_entry(a, struct semaphore_elem, elem);
-   struct semaphore_elem *semaphore_b = list_entry(b, struct semaphore_elem, elem);
+static bool thread_semaphore_comparison(const struct heap_elem *a, const struct heap_elem *b, void *aux UNUSED){
+   // Each condition waiter remembers the thread blocked on it
+   struct semaphore_elem *semaphore_a = heap_entry(a, struct semaphore_elem, elem);
+   struct semaphore_elem *semaphore_b = heap_entry(b, struct semaphore_elem, elem);
 
-   //Then getting the element from the list
-   struct list_elem *elem_a = list_front(&semaphore_a->semaphore.waiters);
-   struct list_elem *elem_b = list_front(&semaphore_b->semaphore.waiters);
+   return waiter_less(semaphore_a->thread, semaphore_a->seq,
+                      semaphore_b->thread, semaphore_b->seq);
+}
 
-   //Getting top threads
-   struct thread *threadA = list_entry(elem_a, struct thread, elem);
-   struct thread *threadB = list_entry(elem_b, struct thread, elem);
+/* Restores the order of every waiter queue that T sits in after
+   T's priority changed.  Interrupts must be off. */
+static void waiter_requeue(struct thread *t){
+   ASSERT (intr_get_level () == INTR_OFF);
 
-   //Comparison of a > b
-   return (threadA->priority) > (threadB->priority);
+   if (t->wait_sema != NULL)
+      heap_update(&t->wait_sema->waiters, &t->wait_elem);
+   if (t->wait_cond != NULL)
+      heap_update(&t->wait_cond->waiters, t->wait_cond_elem);
 }
 
 
@@ -81,6 +101,7 @@ static void donate_priority(struct lock *lock){
    struct lock *cur_lock = lock;      //will be useful in the case that a thread holds multiple threads
    int depth = 0;
    const int limit = 20;
+   enum intr_level old_level = intr_disable();
 
    //Identifying the lock we are waiting on
    current->waiting_on = lock;
@@ -95,6 +116,9 @@ static void donate_priority(struct lock *lock){
 
       if (current->priority > holder->priority){
          holder->priority = current->priority;
+         if (holder->status == THREAD_READY)
+            thread_ready_rearrange(holder);
+         waiter_requeue(holder);
 
          //If the holder is waiting for a lock, then we chain them
          if (holder->waiting_on != NULL){
@@ -111,36 +135,73 @@ static void donate_priority(struct lock *lock){
       depth++;
    }
 
-   //Add the current thread to the lock holder's donor list
-   if (lock->holder != NULL){
-      list_insert_ordered(&lock->holder->donors, &current->donor_elem, thread_priority_comparison, NULL);
-   }
+   //The current thread now counts as a donor through the lock's waiter heap
+   intr_set_level(old_level);
 }
 
 
 
 static void remove_priority(struct lock *lock){
+   struct thread *current = thread_current();
+
+   //Waiters on this lock no longer donate to us
+   list_remove(&lock->elem);
    if (thread_mlfqs){         //mlfqs dont use this
       return;
    }
-   struct thread *current = thread_current();
-   struct list_elem *donators = list_begin(&current->donors);
-   
-   while (donators != list_end(&current->donors)){
-      struct thread *donor = list_entry(donators, struct thread, donor_elem);
-      if (donor->waiting_on == lock){
-         donators = list_remove(donators);
-         donor->waiting_on = NULL;
-      }else{
-         donators = list_next(donators);
-      }
-   }
 
    //Get the new priority because now the inheritor doesn't have this priority anymore
    update_priority(current);
 }
 
-//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/* Returns the priority that the waiters on LOCK donate to its
+   holder, or PRI_MIN - 1 if no thread is waiting.  Interrupts
+   should be off for the result to be stable. */
+int
+lock_donated_priority (const struct lock *lock)
+{
+  const struct heap_elem *e = heap_max (&lock->semaphore.waiters);
+
+  if (e == NULL)
+    return PRI_MIN - 1;
+  return heap_entry (e, struct thread, wait_elem)->priority;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+/* Lock statistics.
+
+   When lock_stats is set, every lock is attached at
+   initialization to the class for its name, and each class
+   accumulates acquisition counts and wait and hold times in
+   timer ticks, with log2 histograms of both.  Classes are never
+   freed, so locks that live in freed memory (such as a dead
+   process's supplemental page table) still have their history
+   reported. */
+#define LOCK_CLASS_MAX 64       /* Max number of distinct names. */
+#define LOCK_HIST_BUCKETS 8     /* 0, 1, 2-3, 4-7, ..., 64+ ticks. */
+
+struct lock_class
+  {
+    const char *name;           /* Name shared by the locks. */
+    long long acquired;         /* # of acquisitions. */
+    long long contended;        /* # that found the lock held. */
+    long long wait_total;       /* Ticks spent waiting. */
+    int64_t wait_max;           /* Longest wait. */
+    long long hold_total;       /* Ticks spent holding. */
+    int64_t hold_max;           /* Longest hold. */
+    long long wait_hist[LOCK_HIST_BUCKETS];
+    long long hold_hist[LOCK_HIST_BUCKETS];
+  };
+
+bool lock_stats;
+static struct lock_class lock_classes[LOCK_CLASS_MAX];
+static int lock_class_cnt;
+static long long lock_class_overflow;   /* Locks left unprofiled. */
+
+static struct lock_class *lock_class_lookup (const char *name);
+static void lock_class_record (long long hist[], int64_t *max,
+                               long long *total, int64_t ticks);
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -157,7 +218,7 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  heap_init (&sema->waiters, thread_priority_comparison, NULL);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -178,7 +239,11 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-      list_insert_ordered (&sema->waiters, &thread_current ()->elem, thread_priority_comparison, NULL);
+      struct thread *cur = thread_current ();
+
+      cur->wait_seq = wait_seq++;
+      cur->wait_sema = sema;
+      heap_insert (&sema->waiters, &cur->wait_elem);
       thread_block ();
     }
   sema->value--;
@@ -224,9 +289,10 @@ sema_up (struct semaphore *sema)
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)){
-     list_sort(&sema->waiters, thread_priority_comparison, NULL);      //Sorting waiters based on their priority
-     struct thread *thread = list_entry (list_pop_front (&sema->waiters), struct thread, elem);
+  if (!heap_empty (&sema->waiters)){
+     //The heap keeps the highest priority waiter on top
+     struct thread *thread = heap_entry (heap_pop_max (&sema->waiters), struct thread, wait_elem);
+     thread->wait_sema = NULL;
      thread_unblock (thread);
 
      //CHeck if the unblocked thread has a higher priority than the current one to yield
@@ -297,12 +363,15 @@ sema_test_helper (void *sema_)
    onerous, it's a good sign that a semaphore should be used,
    instead of a lock. */
 void
-lock_init (struct lock *lock)
+lock_init_named (struct lock *lock, const char *name)
 {
   ASSERT (lock != NULL);
+  ASSERT (name != NULL);
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  lock->class = lock_stats ? lock_class_lookup (name) : NULL;
+  lock->acquired_at = 0;
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -316,10 +385,16 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  bool contended;
+  int64_t start;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  contended = lock->holder != NULL;
+  start = lock->class != NULL ? timer_ticks () : 0;
+
    if (thread_mlfqs) {
    } else {
       //Donate priority
@@ -331,10 +406,25 @@ lock_acquire (struct lock *lock)
    //acquire lock
    sema_down (&lock->semaphore);
    lock->holder = thread_current ();
+   list_push_back (&thread_current ()->held_locks, &lock->elem);
    
    //Once we acquire the lock, it is no longer waiting for the lock
    thread_current()->waiting_on = NULL;
 
+   if (lock->class != NULL)
+     {
+       enum intr_level old_level = intr_disable ();
+       struct lock_class *c = lock->class;
+
+       lock->acquired_at = timer_ticks ();
+       c->acquired++;
+       if (contended)
+         c->contended++;
+       lock_class_record (c->wait_hist, &c->wait_max, &c->wait_total,
+                          lock->acquired_at - start);
+       intr_set_level (old_level);
+     }
+
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -353,7 +443,20 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      lock->holder = thread_current ();
+      list_push_back (&thread_current ()->held_locks, &lock->elem);
+      if (lock->class != NULL)
+        {
+          enum intr_level old_level = intr_disable ();
+
+          lock->acquired_at = timer_ticks ();
+          lock->class->acquired++;
+          lock_class_record (lock->class->wait_hist, &lock->class->wait_max,
+                             &lock->class->wait_total, 0);
+          intr_set_level (old_level);
+        }
+    }
   return success;
 }
 
@@ -370,6 +473,16 @@ lock_release (struct lock *lock)
 
    //Remove the priority donation
    remove_priority(lock);
+
+  if (lock->class != NULL)
+    {
+      enum intr_level old_level = intr_disable ();
+      struct lock_class *c = lock->class;
+
+      lock_class_record (c->hold_hist, &c->hold_max, &c->hold_total,
+                         timer_ticks () - lock->acquired_at);
+      intr_set_level (old_level);
+    }
    
   lock->holder = NULL;
   sema_up (&lock->semaphore);
@@ -387,6 +500,233 @@ lock_held_by_current_thread (const struct lock *lock)
 }
 
 
+/* Prints the statistics of every lock class that was acquired
+   at least once. */
+void
+lock_print_stats (void)
+{
+  int i, j;
+
+  if (!lock_stats)
+    return;
+
+  printf ("Lock statistics (times in ticks; histogram buckets "
+          "0, 1, 2-3, ..., %d+):\n", 1 << (LOCK_HIST_BUCKETS - 2));
+  for (i = 0; i < lock_class_cnt; i++)
+    {
+      const struct lock_class *c = &lock_classes[i];
+
+      if (c->acquired == 0)
+        continue;
+      printf ("  %s: %lld acquired, %lld contended, "
+              "wait %lld total %lld max, hold %lld total %lld max\n",
+              c->name, c->acquired, c->contended,
+              c->wait_total, c->wait_max, c->hold_total, c->hold_max);
+      printf ("    wait:");
+      for (j = 0; j < LOCK_HIST_BUCKETS; j++)
+        printf (" %lld", c->wait_hist[j]);
+      printf ("\n    hold:");
+      for (j = 0; j < LOCK_HIST_BUCKETS; j++)
+        printf (" %lld", c->hold_hist[j]);
+      printf ("\n");
+    }
+  if (lock_class_overflow > 0)
+    printf ("  (%lld locks not profiled: more than %d names)\n",
+            lock_class_overflow, LOCK_CLASS_MAX);
+}
+
+/* Returns the lock class named NAME, creating it if necessary,
+   or a null pointer if the class table is full. */
+static struct lock_class *
+lock_class_lookup (const char *name)
+{
+  struct lock_class *c = NULL;
+  enum intr_level old_level;
+  int i;
+
+  /* Skip the address-of operator left by lock_init(). */
+  if (name[0] == '&')
+    name++;
+
+  old_level = intr_disable ();
+  for (i = 0; i < lock_class_cnt; i++)
+    if (!strcmp (lock_classes[i].name, name))
+      {
+        c = &lock_classes[i];
+        break;
+      }
+  if (c == NULL)
+    {
+      if (lock_class_cnt < LOCK_CLASS_MAX)
+        {
+          c = &lock_classes[lock_class_cnt++];
+          c->name = name;
+        }
+      else
+        lock_class_overflow++;
+    }
+  intr_set_level (old_level);
+
+  return c;
+}
+
+/* Adds a duration of TICKS to histogram HIST, maximum *MAX and
+   sum *TOTAL.  Interrupts must be off. */
+static void
+lock_class_record (long long hist[], int64_t *max, long long *total,
+                   int64_t ticks)
+{
+  int bucket = 0;
+
+  if (ticks > 0)
+    {
+      uint32_t t = ticks < (1 << 30) ? ticks : (1 << 30);
+
+      bucket = 32 - __builtin_clz (t);
+      if (bucket > LOCK_HIST_BUCKETS - 1)
+        bucket = LOCK_HIST_BUCKETS - 1;
+    }
+  hist[bucket]++;
+  *total += ticks;
+  if (ticks > *max)
+    *max = ticks;
+}
+
+/* Initializes RWLOCK as free, naming it NAME for lock
+   statistics. */
+void
+rwlock_init_named (struct rwlock *rwlock, const char *name)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_init_named (&rwlock->lock, name);
+  rwlock->readers = 0;
+  rwlock->writer_waiting = false;
+  sema_init (&rwlock->drained, 0);
+}
+
+/* Acquires RWLOCK for reading, sleeping while a writer holds or
+   is waiting for it.  Other readers may hold RWLOCK at the same
+   time.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rwlock->lock);
+  old_level = intr_disable ();
+  rwlock->readers++;
+  intr_set_level (old_level);
+  lock_release (&rwlock->lock);
+}
+
+/* Tries to acquire RWLOCK for reading and returns true if
+   successful or false if a writer holds it.  This function
+   will not sleep. */
+bool
+rwlock_try_acquire_read (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+
+  ASSERT (rwlock != NULL);
+
+  if (!lock_try_acquire (&rwlock->lock))
+    return false;
+  old_level = intr_disable ();
+  rwlock->readers++;
+  intr_set_level (old_level);
+  lock_release (&rwlock->lock);
+  return true;
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   reading, and wakes a waiting writer if it was the last
+   reader. */
+void
+rwlock_release_read (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+
+  ASSERT (rwlock != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (rwlock->readers > 0);
+  if (--rwlock->readers == 0 && rwlock->writer_waiting)
+    {
+      rwlock->writer_waiting = false;
+      sema_up (&rwlock->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Acquires RWLOCK for writing, sleeping until no other thread
+   holds it.  Readers that arrive after this call wait for the
+   write to finish.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rwlock->lock);
+  old_level = intr_disable ();
+  if (rwlock->readers > 0)
+    {
+      rwlock->writer_waiting = true;
+      sema_down (&rwlock->drained);
+    }
+  intr_set_level (old_level);
+}
+
+/* Tries to acquire RWLOCK for writing and returns true if
+   successful or false if any other thread holds it.  This
+   function will not sleep. */
+bool
+rwlock_try_acquire_write (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  if (!lock_try_acquire (&rwlock->lock))
+    return false;
+  if (rwlock->readers > 0)
+    {
+      lock_release (&rwlock->lock);
+      return false;
+    }
+  return true;
+}
+
+/* Releases RWLOCK, which the current thread must hold for
+   writing. */
+void
+rwlock_release_write (struct rwlock *rwlock)
+{
+  ASSERT (rwlock_held_by_current_thread (rwlock));
+
+  lock_release (&rwlock->lock);
+}
+
+/* Returns true if the current thread holds RWLOCK for writing,
+   false otherwise.  Readers are not tracked. */
+bool
+rwlock_held_by_current_thread (const struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  return lock_held_by_current_thread (&rwlock->lock);
+}
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -395,7 +735,7 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  heap_init (&cond->waiters, thread_semaphore_comparison, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -421,7 +761,9 @@ cond_init (struct condition *cond)
 void
 cond_wait (struct condition *cond, struct lock *lock) 
 {
+  struct thread *cur = thread_current ();
   struct semaphore_elem waiter;
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
@@ -429,7 +771,17 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
-  list_push_back (&cond->waiters, &waiter.elem);
+  waiter.thread = cur;
+
+  /* Donation may reorder COND's waiters without holding LOCK, so
+     update them with interrupts off. */
+  old_level = intr_disable ();
+  waiter.seq = wait_seq++;
+  cur->wait_cond = cond;
+  cur->wait_cond_elem = &waiter.elem;
+  heap_insert (&cond->waiters, &waiter.elem);
+  intr_set_level (old_level);
+
   lock_release (lock);
   sema_down (&waiter.semaphore);
   lock_acquire (lock);
@@ -450,11 +802,15 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)){
-   //Sorting the waiters whenever we get the chance
-    list_sort(&cond->waiters, thread_semaphore_comparison, NULL);
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+  if (!heap_empty (&cond->waiters)){
+    //The heap keeps the waiter with the highest priority thread on top
+    enum intr_level old_level = intr_disable ();
+    struct semaphore_elem *waiter
+      = heap_entry (heap_pop_max (&cond->waiters), struct semaphore_elem, elem);
+
+    waiter->thread->wait_cond = NULL;
+    intr_set_level (old_level);
+    sema_up (&waiter->semaphore);
   }
 }
 
@@ -470,6 +826,6 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
+  while (!heap_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
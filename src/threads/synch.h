@@ -1,6 +1,7 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <heap.h>
 #include <list.h>
 #include <stdbool.h>
 
@@ -8,7 +9,7 @@
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, by priority. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -22,18 +23,55 @@ struct lock
   {
     struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's held_locks. */
+    struct lock_class *class;   /* Statistics, if lock_stats is on. */
+    int64_t acquired_at;        /* Tick of last acquisition. */
   };
 
-void lock_init (struct lock *);
+/* Locks are profiled by name: all locks initialized with the
+   same name share one set of statistics.  lock_init() names a
+   lock after the expression that it is passed. */
+#define lock_init(LOCK) lock_init_named ((LOCK), #LOCK)
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+int lock_donated_priority (const struct lock *);
+
+/* If true, record per-lock acquisition, wait and hold times.
+   Controlled by kernel command-line option "-lockstat". */
+extern bool lock_stats;
+void lock_print_stats (void);
+
+/* Readers-writer lock.  Any number of readers or a single
+   writer may hold it.  A writer holds LOCK for as long as it
+   holds the rwlock, including while it waits for earlier
+   readers to leave, so arriving readers and writers queue
+   behind it on LOCK (writer preference) and donate their
+   priority to it. */
+struct rwlock
+  {
+    struct lock lock;           /* Held by the writer. */
+    unsigned readers;           /* # of readers holding the rwlock. */
+    bool writer_waiting;        /* Writer is waiting for readers. */
+    struct semaphore drained;   /* Upped when the last reader leaves. */
+  };
+
+#define rwlock_init(RWLOCK) rwlock_init_named ((RWLOCK), #RWLOCK)
+void rwlock_init_named (struct rwlock *, const char *name);
+void rwlock_acquire_read (struct rwlock *);
+bool rwlock_try_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+bool rwlock_try_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_held_by_current_thread (const struct rwlock *);
 
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct heap waiters;        /* Waiting threads, by priority. */
   };
 
 void cond_init (struct condition *);
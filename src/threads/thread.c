@@ -5,10 +5,12 @@
 #define DBG_MLFQS(...) do { if (MLFQS_DEBUG) printf(__VA_ARGS__); } while (0)
 #define MLFQS_REPRIO_FMT "mlfqs: reprio @ tick=%lld\n"
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
@@ -35,17 +37,19 @@ static volatile int dbg_last_load_avg_x100 = 0;
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running.  There is one FIFO
+   queue per priority level; bit P of ready_bitmap is set exactly
+   when ready_queues[P] is non-empty, so the highest-priority
+   ready thread is found with a single find-first-set. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint64_t ready_bitmap;
+static int ready_count;             /* # of threads in all queues. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
 
-/* Sleeping list */
-struct list sleeping_list;
-
 /* Idle thread. */
 struct thread *idle_thread;
 
@@ -73,6 +77,37 @@ static long long user_ticks;    /* # of timer ticks in user programs. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
+/* Pages of exited threads kept for reuse by thread_create(), so
+   that process-heavy workloads bypass the page allocator's lock
+   and bitmap scan.  A recycled page is not zeroed: init_thread()
+   resets the struct thread header, including the magic stack
+   canary, and the stack needs no initial contents. */
+#define THREAD_CACHE_MAX 32
+static void *thread_cache[THREAD_CACHE_MAX];
+static size_t thread_cache_cnt;
+static long long thread_cache_hits;     /* Pages reused from cache. */
+static long long thread_cache_misses;   /* Pages from palloc. */
+
+/* Scheduler latency statistics.  Wakeup latency, the time from
+   thread_unblock() to the woken thread running, is kept as a log2
+   histogram of time-stamp counter cycles; bucket B counts
+   latencies below 2**(B + SCHED_HIST_SHIFT) cycles, and the last
+   bucket everything longer. */
+#define SCHED_HIST_SHIFT 10
+#define SCHED_HIST_BUCKETS 24
+bool thread_sched_stats;
+static long long sched_wakeups;
+static uint64_t sched_wakeup_cycles;
+static uint64_t sched_wakeup_max;
+static long long sched_wakeup_hist[SCHED_HIST_BUCKETS];
+
+static void sched_account_switch (struct thread *cur);
+static void sched_account_run (struct thread *cur);
+
+/* Number of pages to put in the thread cache at startup.
+   Controlled by kernel command-line option "-tc=N". */
+size_t thread_cache_prealloc;
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
@@ -89,31 +124,45 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
-static bool thread_priority_comparison(const struct list_elem *a, const struct list_elem *b, void *aux);
 static void thread_update_priority_mlfqs(struct thread *t);
 static void thread_mlfqs_tick(void);
 void update_priority(struct thread *t);
-void mlfqs_update_load_avg_and_recent_cpu_all(void);
-void mlfqs_recompute_priority_all(void);
 static inline int mlfqs_priority_of(const struct thread *t);
+static void mlfqs_catch_up (struct thread *t);
+static void mlfqs_refresh (struct thread *t);
+static void mlfqs_sweep_step (void);
+static void ready_queue_push (struct thread *t);
+static void ready_queue_remove (struct thread *t);
+static struct thread *ready_queue_pop (void);
+static int ready_queue_max_priority (void);
+static struct thread *thread_page_get (void);
+static void thread_page_put (struct thread *);
 
 void mlfqs_dbg_dump(void);
 
 /* System load average - fixed point number */
 fixed_t load_avg;
 
+/* Lazy recent_cpu decay.  mlfqs_epoch counts elapsed seconds and
+   mlfqs_decay[E % MLFQS_DECAY_SLOTS] holds the coefficient
+   2*load_avg/(2*load_avg+1) computed when epoch E began.  Each
+   thread records in rc_epoch the last epoch already folded into
+   its recent_cpu. */
+#define MLFQS_DECAY_SLOTS 64
+static fixed_t mlfqs_decay[MLFQS_DECAY_SLOTS];
+static int mlfqs_epoch;
+
+/* Threads refreshed per tick by mlfqs_sweep_step(), and where in
+   all_list the next step resumes. */
+#define MLFQS_SWEEP_BATCH 4
+static struct list_elem *mlfqs_sweep_cursor;
+
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /*
 Implementing Priority Scheduling below
 */
 
-static bool thread_priority_comparison(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED){
-   struct thread *threadA = list_entry(a, struct thread, elem);
-   struct thread *threadB = list_entry(b, struct thread, elem);
-
-   return ((threadA->priority) > (threadB->priority));
-}
 // Implement ordered insertion to thread_unblock() and thread_yield()
 //////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -122,14 +171,16 @@ void update_priority(struct thread *t){
 //Saving the actual priority for use later
    t->priority = t->base_priority;
 
-//If the thread is already inheriting from another, organize the list of donor so that the highest would be first
-   if (!list_empty(&t->donors)){
-      list_sort(&t->donors, thread_priority_comparison,NULL);            //Sort so that highest prio thread is first
-      struct thread *highest_prio = list_entry(list_front(&t->donors), struct thread, donor_elem);   //Get the first thread
-      if ((highest_prio->priority) > (t->priority)){               // Compare thread with the donor and if the donor is higher, then inherit prio
-         t->priority = highest_prio->priority;
+//Inherit from the highest priority waiter on any lock we still hold; each lock's waiters keep their max on top
+   enum intr_level old_level = intr_disable();
+   struct list_elem *e;
+   for (e = list_begin(&t->held_locks); e != list_end(&t->held_locks); e = list_next(e)){
+      int donated = lock_donated_priority(list_entry(e, struct lock, elem));
+      if (donated > t->priority){               // Compare thread with the donor and if the donor is higher, then inherit prio
+         t->priority = donated;
       }
    }
+   intr_set_level(old_level);
 }
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /* Initializes the threading system by transforming the code
@@ -148,15 +199,19 @@ void update_priority(struct thread *t){
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   /* Initialize load_avg to 0 */
   load_avg = 0;
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = PRI_MIN; i <= PRI_MAX; i++)
+    list_init (&ready_queues[i]);
+  ready_bitmap = 0;
+  ready_count = 0;
   list_init (&all_list);
-  list_init (&sleeping_list);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -175,6 +230,18 @@ thread_start (void)
   mmap_init(&initial_thread->mmap_list);  // ADD THIS LINE
 #endif
 
+  /* Fill the thread page cache, now that the page allocator is
+     up. */
+  if (thread_cache_prealloc > THREAD_CACHE_MAX)
+    thread_cache_prealloc = THREAD_CACHE_MAX;
+  while (thread_cache_cnt < thread_cache_prealloc)
+    {
+      void *page = palloc_get_page (0);
+      if (page == NULL)
+        break;
+      thread_cache[thread_cache_cnt++] = page;
+    }
+
   /* Create the idle thread. */
   struct semaphore idle_started;
   sema_init (&idle_started, 0);
@@ -226,45 +293,21 @@ static void thread_mlfqs_tick(void) {
     thread_update_priority_mlfqs(cur);  // uses mlfqs_priority_of()
   }
 
+  /* Let a few ready threads catch up on missed decays. */
+  mlfqs_sweep_step ();
+
   /* 3) If a higher-priority ready thread exists, preempt on return */
-  if (!list_empty(&ready_list)) {
-    int best = list_entry(list_front(&ready_list), struct thread, elem)->priority;
-    if (best > cur->priority)
-      intr_yield_on_return();
-  }
+  if (ready_queue_max_priority () > cur->priority)
+    intr_yield_on_return();
 }
 
 
-bool
-list_sleep_less_func (const struct list_elem *a,
-                      const struct list_elem *b,
-                      void *aux UNUSED)
-{
-    struct thread *thread_a = list_entry (a, struct thread, sleepelem);
-    struct thread *thread_b = list_entry (b, struct thread, sleepelem);
-
-    return thread_a->wakeup_tick < thread_b->wakeup_tick;
-}
-
+/* Charges N timer ticks that passed without a timer interrupt,
+   during tickless idle, to the idle thread. */
 void
-thread_sleep (int64_t ticks){
-    struct thread *t = thread_current ();
-    enum intr_level old_level;
-    if (t == idle_thread){return;}
-
-    old_level = intr_disable ();
-    t->wakeup_tick = ticks;
-
-    list_insert_ordered(&sleeping_list, &t->sleepelem, (list_less_func *) list_sleep_less_func, NULL);
-
-    if (t->wakeup_tick < next_wakeup_tick){
-      next_wakeup_tick = t->wakeup_tick;
-    }
-
-    t->status = THREAD_BLOCKED;
-    schedule();
-
-    intr_set_level (old_level);
+thread_account_idle_ticks (int64_t n)
+{
+  idle_ticks += n;
 }
 
 /* Prints thread statistics. */
@@ -273,6 +316,8 @@ thread_print_stats (void)
 {
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+  printf ("Thread cache: %lld hits, %lld misses\n",
+          thread_cache_hits, thread_cache_misses);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -303,7 +348,7 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = thread_page_get ();
   if (t == NULL)
     return TID_ERROR;
 
@@ -369,18 +414,26 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-   //Making sure our list is still ordered with ordered insert
-  list_insert_ordered (&ready_list, &t->elem, thread_priority_comparison, NULL);
+  if (thread_mlfqs && t != idle_thread)
+    {
+      mlfqs_catch_up (t);
+      t->priority = mlfqs_priority_of (t);
+    }
+  {
+    uint64_t now = cpu_cycles ();
+
+    t->blocked_cycles += now - t->sched_stamp;
+    t->sched_stamp = now;
+    t->woken = true;
+  }
+  ready_queue_push (t);
   t->status = THREAD_READY;
   DBG_MLFQS("READY ENQ: %s pr=%d\n", t->name, t->priority);
 
    //Getting the current thread
   if (intr_context()){
-    if(!list_empty(&ready_list)){
-      struct thread *front = list_entry(list_front(&ready_list), struct thread, elem);
-      if ((front->priority) > (thread_current()->priority)){
-        intr_yield_on_return();   //Must be this because interrupts are disabled so we have to wait
-      }
+    if (ready_queue_max_priority () > thread_current()->priority){
+      intr_yield_on_return();   //Must be this because interrupts are disabled so we have to wait
     }
   }
   intr_set_level (old_level);
@@ -434,6 +487,8 @@ thread_exit (void)
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable ();
+  if (mlfqs_sweep_cursor == &thread_current ()->allelem)
+    mlfqs_sweep_cursor = list_next (mlfqs_sweep_cursor);
   list_remove (&thread_current()->allelem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
@@ -452,9 +507,10 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
-     //When inserting the current thread, make sure that it is placed in order
-    list_insert_ordered (&ready_list, &cur->elem, thread_priority_comparison, NULL);
-    DBG_MLFQS("READY ENQ: %s pr=%d\n", cur->name, cur->priority);
+    {
+      ready_queue_push (cur);
+      DBG_MLFQS("READY ENQ: %s pr=%d\n", cur->name, cur->priority);
+    }
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
@@ -491,12 +547,7 @@ thread_set_priority (int new_priority)
    update_priority(current);
    
    /*Once we have set the new priority, we gotta check whether to yield to next process */  
-   if (!list_empty(&ready_list)){
-      struct thread *front = list_entry(list_front(&ready_list), struct thread, elem);
-      if ((front->priority)>(current->priority)){
-         thread_yield();
-      }
-   }
+   try_thread_yield ();
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 }
 
@@ -511,6 +562,9 @@ thread_get_priority (void)
 void
 thread_set_nice (int nice UNUSED) 
 {
+  enum intr_level old_level = intr_disable ();
+  mlfqs_catch_up (thread_current ());
+  intr_set_level (old_level);
   thread_current ()->nice = nice;
   DBG_MLFQS("nice set: %s nice=%d recent_cpu=%d\n", thread_name(), nice, FP_INT_PART(thread_current()->recent_cpu));
   /* When the NICE is changed, the priority is possibly changed. */
@@ -538,6 +592,9 @@ thread_get_load_avg (void)
 int
 thread_get_recent_cpu (void) 
 {
+  enum intr_level old_level = intr_disable ();
+  mlfqs_catch_up (thread_current ());
+  intr_set_level (old_level);
   return FP_ROUND (FP_MULT_MIX (thread_current ()->recent_cpu, 100));
 }
 
@@ -550,9 +607,7 @@ void
 try_thread_yield (void)
 {
   enum intr_level old_level = intr_disable ();
-  bool need_yield = !list_empty (&ready_list) &&
-                list_entry (list_front (&ready_list), struct thread, elem)->priority >
-	            thread_get_priority ();
+  bool need_yield = ready_queue_max_priority () > thread_get_priority ();
   intr_set_level (old_level);
   
   if (need_yield)
@@ -560,19 +615,93 @@ try_thread_yield (void)
 }
 
 /* If the priority of a ready thread changes, this function should be called
-   to re-arrange the order of the READY LIST. */
+   to move it to the ready queue matching its new priority. */
 void
 thread_ready_rearrange (struct thread *t)
 {
   ASSERT (t->status == THREAD_READY);
   
   enum intr_level old_level = intr_disable ();
-  list_remove (&t->elem);
-  list_insert_ordered (&ready_list, &t->elem,
-                       thread_priority_comparison, NULL);
+  if (t->ready_priority != t->priority)
+    {
+      ready_queue_remove (t);
+      ready_queue_push (t);
+    }
   intr_set_level (old_level);
 }
 
+/* Returns the number of threads in the ready queues. */
+int
+thread_ready_count (void)
+{
+  return ready_count;
+}
+
+/* Appends T to the back of the ready queue for its current
+   priority.  Interrupts must be off. */
+static void
+ready_queue_push (struct thread *t)
+{
+  int pri = t->priority;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= pri && pri <= PRI_MAX);
+
+  list_push_back (&ready_queues[pri], &t->elem);
+  ready_bitmap |= (uint64_t) 1 << pri;
+  t->ready_priority = pri;
+  ready_count++;
+}
+
+/* Removes T from the ready queue it was pushed onto.  Interrupts
+   must be off. */
+static void
+ready_queue_remove (struct thread *t)
+{
+  int pri = t->ready_priority;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[pri]))
+    ready_bitmap &= ~((uint64_t) 1 << pri);
+  ready_count--;
+}
+
+/* Returns the highest priority with a non-empty ready queue, or
+   PRI_MIN - 1 if no thread is ready.  The bitmap is scanned as
+   two 32-bit halves so that each half compiles to a single BSR
+   instead of a call into libgcc. */
+static int
+ready_queue_max_priority (void)
+{
+  uint32_t hi = ready_bitmap >> 32;
+  uint32_t lo = ready_bitmap;
+
+  if (hi != 0)
+    return 63 - __builtin_clz (hi);
+  else if (lo != 0)
+    return 31 - __builtin_clz (lo);
+  else
+    return PRI_MIN - 1;
+}
+
+/* Removes and returns the oldest thread in the highest-priority
+   non-empty ready queue, or NULL if no thread is ready.
+   Interrupts must be off. */
+static struct thread *
+ready_queue_pop (void)
+{
+  int pri = ready_queue_max_priority ();
+  struct thread *t;
+
+  if (pri < PRI_MIN)
+    return NULL;
+  t = list_entry (list_front (&ready_queues[pri]), struct thread, elem);
+  ready_queue_remove (t);
+  return t;
+}
+
 /* Update the priority in the MLFQS way (uses truncation via helper). */
 static void
 thread_update_priority_mlfqs(struct thread *t)
@@ -600,12 +729,103 @@ static inline int mlfqs_priority_of(const struct thread *t) {
   return pr;
 }
 
-/* This function is about what will happen per second with mlfqs. */
-void mlfqs_update_load_avg_and_recent_cpu_all(void) {
-  enum intr_level old_level = intr_disable ();
+/* Applies every recent_cpu decay that T has missed since it was
+   last brought up to date.  Decays are applied lazily rather than
+   to every thread once a second; the coefficient used at each
+   one-second epoch stays in mlfqs_decay[] until it is overwritten
+   MLFQS_DECAY_SLOTS epochs later.  A thread that slept longer
+   than that replays the oldest remembered coefficient for the
+   missing epochs, a bounded number of times, since recent_cpu
+   converges geometrically anyway.  Interrupts must be off. */
+static void
+mlfqs_catch_up (struct thread *t)
+{
+  int missed = mlfqs_epoch - t->rc_epoch;
+
+  if (missed <= 0)
+    return;
+  if (t == idle_thread)
+    {
+      t->rc_epoch = mlfqs_epoch;
+      return;
+    }
+
+  if (missed > MLFQS_DECAY_SLOTS)
+    {
+      int oldest = mlfqs_epoch - MLFQS_DECAY_SLOTS + 1;
+      fixed_t coeff = mlfqs_decay[oldest % MLFQS_DECAY_SLOTS];
+      int extra = missed - MLFQS_DECAY_SLOTS;
+
+      if (extra > MLFQS_DECAY_SLOTS)
+        extra = MLFQS_DECAY_SLOTS;
+      while (extra-- > 0)
+        t->recent_cpu = FP_ADD (FP_MULT (coeff, t->recent_cpu),
+                                FP_CONST (t->nice));
+      t->rc_epoch = mlfqs_epoch - MLFQS_DECAY_SLOTS;
+    }
+
+  while (t->rc_epoch < mlfqs_epoch)
+    {
+      fixed_t coeff;
 
-  int ready_threads = (int)list_size(&ready_list);
-  if (thread_current() != idle_thread) ready_threads += 1;
+      t->rc_epoch++;
+      coeff = mlfqs_decay[t->rc_epoch % MLFQS_DECAY_SLOTS];
+      t->recent_cpu = FP_ADD (FP_MULT (coeff, t->recent_cpu),
+                              FP_CONST (t->nice));
+    }
+}
+
+/* Brings T's recent_cpu up to date and moves it to the ready
+   queue for its new priority if that changed. */
+static void
+mlfqs_refresh (struct thread *t)
+{
+  if (t == idle_thread || t->rc_epoch == mlfqs_epoch)
+    return;
+  mlfqs_catch_up (t);
+  thread_update_priority_mlfqs (t);
+}
+
+/* Refreshes up to MLFQS_SWEEP_BATCH threads, continuing
+   round-robin over all_list from where the previous call
+   stopped, so that threads sitting in the ready queues pick up
+   their decayed recent_cpu without a full sweep at the
+   one-second edge.  Runs in the timer interrupt. */
+static void
+mlfqs_sweep_step (void)
+{
+  int n;
+
+  for (n = 0; n < MLFQS_SWEEP_BATCH && !list_empty (&all_list); n++)
+    {
+      struct thread *t;
+
+      if (mlfqs_sweep_cursor == NULL
+          || mlfqs_sweep_cursor == list_end (&all_list))
+        mlfqs_sweep_cursor = list_begin (&all_list);
+      t = list_entry (mlfqs_sweep_cursor, struct thread, allelem);
+      mlfqs_sweep_cursor = list_next (mlfqs_sweep_cursor);
+
+      if (t->status == THREAD_READY)
+        mlfqs_refresh (t);
+    }
+}
+
+/* Per-second MLFQS bookkeeping, called from the timer interrupt.
+   Updates load_avg from the running ready count and records this
+   second's recent_cpu decay coefficient.  Only the running thread
+   is decayed here; every other thread catches up in
+   mlfqs_catch_up() when it is next woken, scheduled, queried or
+   swept, so this is constant time however many threads exist. */
+void
+thread_tick_one_second_mlfqs (void)
+{
+  struct thread *cur = thread_current ();
+  int ready_threads = ready_count;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (cur != idle_thread) ready_threads += 1;
 
   fixed_t term1 = FP_MULT_MIX(load_avg, 59);
   term1 = FP_DIV_MIX(term1, 60);
@@ -619,35 +839,19 @@ void mlfqs_update_load_avg_and_recent_cpu_all(void) {
             FP_ROUND(FP_MULT_MIX(load_avg,100))%100, ready_threads);
 
   fixed_t two_la = FP_MULT_MIX(load_avg, 2);
-  fixed_t coeff = FP_DIV(two_la, FP_ADD_MIX(two_la, 1));
+  mlfqs_epoch++;
+  mlfqs_decay[mlfqs_epoch % MLFQS_DECAY_SLOTS] = FP_DIV(two_la, FP_ADD_MIX(two_la, 1));
 
-  struct list_elem *e;
-  for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
-    struct thread *t = list_entry(e, struct thread, allelem);
-    if (t == idle_thread) continue;
-    t->recent_cpu = FP_ADD(FP_MULT(coeff, t->recent_cpu), FP_CONST(t->nice));
-  }
-  intr_set_level (old_level);
-}
-
-// Recompute priorities of all threads
-void mlfqs_recompute_priority_all(void) {
-  if (MLFQS_DEBUG && (timer_ticks() % 4 == 0))
+  if (MLFQS_DEBUG)
     DBG_MLFQS(MLFQS_REPRIO_FMT, (long long) timer_ticks());
 
-  // Recompute priorities
-  struct list_elem *e;
-  for (e = list_begin(&all_list); e != list_end(&all_list); e = list_next(e)) {
-    struct thread *t = list_entry(e, struct thread, allelem);
-    if (t == idle_thread) continue;
-    t->priority = mlfqs_priority_of(t);
-  }
-
-  // Reorder ready list ONCE
-  enum intr_level old = intr_disable();
-  if (!list_empty(&ready_list))
-    list_sort(&ready_list, thread_priority_comparison, NULL);
-  intr_set_level(old);
+  if (cur != idle_thread)
+    {
+      mlfqs_catch_up (cur);
+      cur->priority = mlfqs_priority_of (cur);
+      if (ready_queue_max_priority () > cur->priority)
+        intr_yield_on_return ();
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////////
@@ -681,6 +885,10 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* With nothing to run, stop the periodic tick until the
+         next timer deadline if tickless idle is enabled. */
+      timer_idle_enter ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -694,6 +902,7 @@ idle (void *idle_started_ UNUSED)
          See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
          7.11.1 "HLT Instruction". */
       asm volatile ("sti; hlt" : : : "memory");
+      timer_idle_exit ();
     }
 }
 
@@ -745,10 +954,11 @@ init_thread (struct thread *t, const char *name, int priority)
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
   t->magic = THREAD_MAGIC;
+  t->sched_stamp = cpu_cycles ();
 
   /* Priority donation bookkeeping */
   t->base_priority = priority;
-  list_init(&t->donors);
+  list_init(&t->held_locks);
   t->waiting_on = NULL;
 
   /* user prog child list initilization*/
@@ -760,6 +970,7 @@ init_thread (struct thread *t, const char *name, int priority)
   /* MLFQS fields */
   t->nice = 0;
   t->recent_cpu = 0;
+  t->rc_epoch = mlfqs_epoch;
 
   if (thread_mlfqs) {
     if (t == idle_thread) {
@@ -775,6 +986,7 @@ init_thread (struct thread *t, const char *name, int priority)
     } else {
       /* New thread inherits nice/recent_cpu from current, then compute. */
       struct thread *cur = running_thread(); /* safe here */
+      mlfqs_catch_up(cur);
       t->nice = cur->nice;
       t->recent_cpu = cur->recent_cpu;
       t->priority = mlfqs_priority_of(t);
@@ -824,11 +1036,9 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
-  else
-     //No need to change this as long as we keep updating "ready_list" with the highest priority being first for it to be chosen
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+  struct thread *next = ready_queue_pop ();
+
+  return next != NULL ? next : idle_thread;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -856,10 +1066,20 @@ thread_schedule_tail (struct thread *prev)
 
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
+  sched_account_run (cur);
+
+  /* Fold in any recent_cpu decays missed while waiting. */
+  if (thread_mlfqs)
+    mlfqs_catch_up (cur);
 
   /* Start new time slice. */
   thread_ticks = 0;
 
+  /* An interrupt woke a thread while the idle thread was in a
+     tickless halt: restart the periodic tick before it runs. */
+  if (prev == idle_thread)
+    timer_idle_exit ();
+
 #ifdef USERPROG
   /* Activate the new address space. */
   process_activate ();
@@ -873,7 +1093,7 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      thread_page_put (prev);
     }
 }
 
@@ -895,6 +1115,7 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  sched_account_switch (cur);
   if (cur != next)
     prev = switch_threads (cur, next);
   thread_schedule_tail (prev);
@@ -923,18 +1144,159 @@ void mlfqs_dbg_dump(void) {
          dbg_second_edges, dbg_recompute_4tick, dbg_preemptions, dbg_last_load_avg_x100);
 }
 
-void thread_set_sleeping(int64_t ticks) {
-  struct thread *cur = thread_current();
-  cur->wakeup_tick = timer_ticks() + ticks;
-  /* Insert sorted by wakeup_tick to make wakeups O(1) average */
-  struct list_elem *e = list_begin(&sleeping_list);
-  while (e != list_end(&sleeping_list)) {
-    struct thread *t = list_entry(e, struct thread, sleepelem);
-    if (cur->wakeup_tick < t->wakeup_tick) break;
-    e = list_next(e);
-  }
-  list_insert(e, &cur->sleepelem);
-  thread_block();
+/* Returns a page for a new thread, from the thread cache if it
+   is not empty or else from the page allocator.  Returns a null
+   pointer if no page is available. */
+static struct thread *
+thread_page_get (void)
+{
+  void *page = NULL;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (thread_cache_cnt > 0)
+    {
+      page = thread_cache[--thread_cache_cnt];
+      thread_cache_hits++;
+    }
+  else
+    thread_cache_misses++;
+  intr_set_level (old_level);
+
+  if (page == NULL)
+    page = palloc_get_page (0);
+  return page;
+}
+
+/* Releases the page of dead thread T, keeping it in the thread
+   cache if there is room. */
+static void
+thread_page_put (struct thread *t)
+{
+  bool cached = false;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (thread_cache_cnt < THREAD_CACHE_MAX)
+    {
+      thread_cache[thread_cache_cnt++] = t;
+      cached = true;
+    }
+  intr_set_level (old_level);
+
+  if (!cached)
+    palloc_free_page (t);
+}
+
+/* Charges the time since CUR's last state change to running and
+   counts the switch away from CUR, voluntary if CUR blocked and
+   involuntary if it was put back on a run queue.  Interrupts
+   must be off. */
+static void
+sched_account_switch (struct thread *cur)
+{
+  uint64_t now = cpu_cycles ();
+
+  cur->run_cycles += now - cur->sched_stamp;
+  cur->sched_stamp = now;
+  if (cur->status == THREAD_BLOCKED)
+    cur->voluntary_switches++;
+  else if (cur->status == THREAD_READY)
+    cur->involuntary_switches++;
 }
 
+/* Charges the time since CUR's last state change to waiting in a
+   run queue, now that CUR runs again, and records its wakeup
+   latency if it got there by thread_unblock().  Interrupts must
+   be off. */
+static void
+sched_account_run (struct thread *cur)
+{
+  uint64_t now = cpu_cycles ();
+  uint64_t waited = now - cur->sched_stamp;
+
+  cur->ready_cycles += waited;
+  cur->sched_stamp = now;
+  if (cur->woken)
+    {
+      int bucket = 0;
+
+      cur->woken = false;
+      sched_wakeups++;
+      sched_wakeup_cycles += waited;
+      if (waited > sched_wakeup_max)
+        sched_wakeup_max = waited;
+      while (bucket < SCHED_HIST_BUCKETS - 1
+             && waited >= (uint64_t) 1 << (bucket + SCHED_HIST_SHIFT))
+        bucket++;
+      sched_wakeup_hist[bucket]++;
+    }
+}
+
+/* Clears the scheduler latency statistics of every thread and
+   the wakeup latency histogram, so that a test can measure just
+   the workload that follows. */
+void
+thread_sched_stats_reset (void)
+{
+  enum intr_level old_level = intr_disable ();
+  uint64_t now = cpu_cycles ();
+  struct list_elem *e;
 
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+
+      t->sched_stamp = now;
+      t->run_cycles = t->ready_cycles = t->blocked_cycles = 0;
+      t->voluntary_switches = t->involuntary_switches = 0;
+    }
+  sched_wakeups = 0;
+  sched_wakeup_cycles = 0;
+  sched_wakeup_max = 0;
+  memset (sched_wakeup_hist, 0, sizeof sched_wakeup_hist);
+  intr_set_level (old_level);
+}
+
+/* Prints the run, ready and blocked time and the context switch
+   counts of each live thread, then the wakeup latency
+   histogram.  Times are in microseconds. */
+void
+thread_print_sched_stats (void)
+{
+  struct list_elem *e;
+  int i;
+
+  printf ("Scheduler (%s): times in us\n",
+          thread_mlfqs ? "mlfqs" : "priority");
+  printf ("  %-16s %10s %10s %10s %8s %8s\n",
+          "thread", "run", "ready", "blocked", "vol", "invol");
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+
+      printf ("  %-16s %10"PRIu64" %10"PRIu64" %10"PRIu64" %8u %8u\n",
+              t->name, timer_cycles_to_us (t->run_cycles),
+              timer_cycles_to_us (t->ready_cycles),
+              timer_cycles_to_us (t->blocked_cycles),
+              t->voluntary_switches, t->involuntary_switches);
+    }
+
+  printf ("  %lld wakeups, latency avg %"PRIu64" us, max %"PRIu64" us\n",
+          sched_wakeups,
+          sched_wakeups > 0
+          ? timer_cycles_to_us (sched_wakeup_cycles / sched_wakeups) : 0,
+          timer_cycles_to_us (sched_wakeup_max));
+  for (i = 0; i < SCHED_HIST_BUCKETS; i++)
+    if (sched_wakeup_hist[i] > 0)
+      {
+        if (i < SCHED_HIST_BUCKETS - 1)
+          printf ("    < %8"PRIu64" us: %lld\n",
+                  timer_cycles_to_us ((uint64_t) 1 << (i + SCHED_HIST_SHIFT)),
+                  sched_wakeup_hist[i]);
+        else
+          printf ("    longer      : %lld\n", sched_wakeup_hist[i]);
+      }
+}
@@ -76,8 +76,7 @@ struct thread
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /* implementation to include priority donation */
     int base_priority;                  // Base priority of current thread
-    struct list donors;                  // List of threads that are donating
-    struct list_elem donor_elem;        // Element of the donor list
+    struct list held_locks;             // Locks held; their waiters are our donors
     struct lock *waiting_on;            // The lock that our thread is waiting on
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -94,11 +93,29 @@ struct thread
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
+    int ready_priority;                 /* Ready queue holding elem. */
+
+    /* Scheduler accounting, in time-stamp counter cycles. */
+    uint64_t sched_stamp;               /* Time of last state change. */
+    uint64_t run_cycles;                /* Time spent running. */
+    uint64_t ready_cycles;              /* Time spent ready, not running. */
+    uint64_t blocked_cycles;            /* Time spent blocked. */
+    unsigned voluntary_switches;        /* Switches away by blocking. */
+    unsigned involuntary_switches;      /* Switches away by yielding. */
+    bool woken;                         /* Ready since thread_unblock(). */
+
+    /* Owned by synch.c. */
+    struct heap_elem wait_elem;         /* Element in wait_sema's waiters. */
+    unsigned wait_seq;                  /* Order of arrival at wait_sema. */
+    struct semaphore *wait_sema;        /* Semaphore blocked on, if any. */
+    struct condition *wait_cond;        /* Condition waited on, if any. */
+    struct heap_elem *wait_cond_elem;   /* Our element in wait_cond. */
 
     /* Owned by thread.c and synch.c. */
 	int nice;                           /* Determines how nice a thread should
    be to other threads. */
    fixed_t recent_cpu;                 /* The recent cpu. */
+   int rc_epoch;                       /* Last decay epoch applied. */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
@@ -111,17 +128,10 @@ struct thread
     struct list mmap_list;              // List of memory mappings
 #endif
 
-
-    /* Sleeping support */
-    struct list_elem sleepelem;          /* in sleeping_list */
-    int64_t wakeup_tick;                  /* absolute tick to wake */
-
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
 
-extern struct list ready_list;
-extern struct list sleeping_list;
 extern struct thread *idle_thread;
 extern fixed_t load_avg;
 
@@ -130,16 +140,24 @@ extern fixed_t load_avg;
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* Number of thread pages to preallocate for reuse by
+   thread_create().  Controlled by kernel command-line option
+   "-tc=N". */
+extern size_t thread_cache_prealloc;
+
 void thread_init (void);
 void thread_start (void);
 
-void thread_sleep(int64_t wakeup_tick);
-
-bool list_sleep_less_func(const struct list_elem *a, const struct list_elem *b, void *aux);
-
 void thread_tick (void);
+void thread_account_idle_ticks (int64_t);
 void thread_print_stats (void);
 
+/* If true, print scheduler latency statistics at shutdown.
+   Controlled by kernel command-line option "-schedstat". */
+extern bool thread_sched_stats;
+void thread_sched_stats_reset (void);
+void thread_print_sched_stats (void);
+
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
 
@@ -165,17 +183,13 @@ void thread_set_nice (int);
 int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 
-void mlfqs_update_load_avg_and_recent_cpu_all(void);
-void mlfqs_recompute_priority_all(void);
-
 void try_thread_yield (void);
 
 void thread_update_priority (struct thread *);
 
 void thread_ready_rearrange (struct thread *);
+int thread_ready_count (void);
 
 void thread_tick_one_second_mlfqs (void);
 
-void thread_set_sleeping(int64_t ticks);
-
 #endif /* threads/thread.h */
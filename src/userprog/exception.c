@@ -172,8 +172,17 @@ page_fault (struct intr_frame *f)
             }
         }
       
-      /* Try to load page from supplemental page table */
-      if (not_present && spt_load_page(&t->spt, fault_addr))
+      /* A write to a page shared since fork() copies it */
+      if (!not_present && write && spt_break_cow(&t->spt, fault_addr))
+        return;  /* Success */
+
+      /* A read of a zero page maps the shared zero page */
+      if (not_present && !write && spt_map_zero(&t->spt, fault_addr))
+        return;  /* Success */
+
+      /* Try to load page from supplemental page table.  A write to
+         a page mapped to the shared zero page gets it a frame. */
+      if ((not_present || write) && spt_load_page(&t->spt, fault_addr))
         return;  /* Success */
     }
 #endif
@@ -26,9 +26,11 @@
 #ifdef VM
 #include "vm/page.h"
 #include "vm/frame.h"
+#include "vm/mmap.h"
 #endif
 
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 static void parse_args(char *cmd_line, char **argv, int *argc);
 
@@ -207,6 +209,192 @@ start_process (void *data_)
   NOT_REACHED ();
 }
 
+/* helper struct to pass the parent to a forked child*/
+struct fork_data{
+  struct thread *parent;
+  struct intr_frame if_;
+  struct child_process *child;
+};
+
+/* Creates a copy of the current process, which returns from the
+   system call interrupted at F with 0 while the parent gets the
+   child's pid, or TID_ERROR if the copy cannot be made. */
+tid_t
+process_fork (const struct intr_frame *f)
+{
+  struct thread *cur = thread_current();
+  tid_t tid;
+
+  struct child_process *child = malloc(sizeof(struct child_process));
+  if (child == NULL)
+    return TID_ERROR;
+
+  child->load_status = false;
+  sema_init(&child->load_sema, 0);
+  child->parent_thread = cur;
+  child->exit_status = -1;
+  child->exited = false;
+  sema_init(&child->wait_sema, 0);
+
+  struct fork_data data;
+  data.parent = cur;
+  data.if_ = *f;
+  data.child = child;
+
+  tid = thread_create (cur->name, PRI_DEFAULT, start_fork, &data);
+  if (tid == TID_ERROR){
+    free(child);
+    return TID_ERROR;
+  }
+
+  /* The child copies our memory and files before it runs, so we
+     must not touch them until it is done */
+  child->pid = tid;
+  sema_down(&child->load_sema);
+  if (child->load_status == true){
+    list_push_back (&cur->children, &child->elem);
+  }
+  else {
+    free(child);
+    tid = TID_ERROR;
+  }
+  return tid;
+}
+
+#ifdef VM
+/* Translates FILE, one of PARENT's, to the current thread's copy
+   of it for spt_fork().  The mappings of the child are copied in
+   the parent's order. */
+static struct file *
+fork_map_file (struct file *file, void *parent_)
+{
+  struct thread *parent = parent_;
+  struct thread *t = thread_current();
+  struct list_elem *pe, *ce;
+
+  if (file == parent->executable)
+    return t->executable;
+  for (pe = list_begin (&parent->mmap_list), ce = list_begin (&t->mmap_list);
+       pe != list_end (&parent->mmap_list) && ce != list_end (&t->mmap_list);
+       pe = list_next (pe), ce = list_next (ce))
+    if (list_entry (pe, struct mmap_mapping, elem)->file == file)
+      return list_entry (ce, struct mmap_mapping, elem)->file;
+  return NULL;
+}
+#endif
+
+/* Copies the parent's open files into the current thread.  Each
+   gets a file of its own at the same position, so positions are
+   not shared afterward.  Returns false if memory runs out. */
+static bool
+fork_files (struct thread *parent)
+{
+  struct thread *t = thread_current();
+  int i;
+
+  if (parent->executable != NULL){
+    t->executable = file_reopen(parent->executable);
+    if (t->executable == NULL)
+      return false;
+    file_deny_write(t->executable);
+  }
+
+  for (i = 2; i < FD_MAX; i++){
+    struct file *pf = parent->file_descriptors[i];
+    if (pf == NULL)
+      continue;
+    t->file_descriptors[i] = file_reopen(pf);
+    if (t->file_descriptors[i] == NULL)
+      return false;
+    file_seek(t->file_descriptors[i], file_tell(pf));
+  }
+
+#ifdef VM
+  struct list_elem *e;
+  for (e = list_begin (&parent->mmap_list); e != list_end (&parent->mmap_list);
+       e = list_next (e))
+    {
+      struct mmap_mapping *pm = list_entry (e, struct mmap_mapping, elem);
+      struct mmap_mapping *m = malloc(sizeof *m);
+      if (m == NULL)
+        return false;
+      *m = *pm;
+      m->file = file_reopen(pm->file);
+      if (m->file == NULL){
+        free(m);
+        return false;
+      }
+      list_push_back (&t->mmap_list, &m->elem);
+    }
+#endif
+  return true;
+}
+
+/* Closes whatever fork_files() managed to open.  Mappings are left
+   for process_exit(). */
+static void
+fork_close_files (void)
+{
+  struct thread *t = thread_current();
+  int i;
+
+  if (t->executable != NULL){
+    file_allow_write(t->executable);
+    file_close(t->executable);
+    t->executable = NULL;
+  }
+  for (i = 2; i < FD_MAX; i++)
+    if (t->file_descriptors[i] != NULL){
+      file_close(t->file_descriptors[i]);
+      t->file_descriptors[i] = NULL;
+    }
+}
+
+static void
+start_fork (void *data_)
+{
+  struct fork_data *data = (struct fork_data *) data_;
+  struct thread *parent = data->parent;
+  struct child_process *child = data->child;
+  struct thread *t = thread_current();
+  struct intr_frame if_ = data->if_;
+  bool success = false;
+
+  t->pagedir = pagedir_create ();
+  if (t->pagedir == NULL)
+    goto done;
+  process_activate ();
+
+  lock_acquire(&file_lock);
+  success = fork_files(parent);
+  lock_release(&file_lock);
+
+#ifdef VM
+  if (success)
+    success = spt_fork(parent, fork_map_file, parent);
+#endif
+
+ done:
+  if (success)
+    t->my_record = child;
+  else {
+    lock_acquire(&file_lock);
+    fork_close_files();
+    lock_release(&file_lock);
+  }
+  child->load_status = success;
+  sema_up(&child->load_sema);
+
+  if (!success){
+    thread_exit ();
+  }
+
+  /* fork() returns 0 in the child */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
 int
 process_wait (tid_t child_tid UNUSED) 
 {
@@ -580,6 +768,7 @@ setup_stack (void **esp)
             {
               *esp = PHYS_BASE;
               spt_set_loaded(&thread_current()->spt, upage, kpage);
+              frame_done(kpage);
             }
           else
             frame_free(kpage);
@@ -44,6 +44,9 @@ static unsigned sys_tell(int fd);
 #ifdef VM
 static mapid_t sys_mmap(int fd, void *addr);
 static void sys_munmap(mapid_t mapid);
+static int sys_madvise(void *addr, unsigned length, int advice);
+static int sys_mlock(void *addr, unsigned length);
+static int sys_munlock(void *addr, unsigned length);
 #endif
 
 static void uaddr_check(const void *u);
@@ -59,7 +62,7 @@ static struct file *fd_get(int fd);
 static bool copy_out(void *udst, const void *ksrc, size_t n);
 
 #ifdef VM
-static void pin_buffer(const void *buffer, size_t size);
+static bool pin_buffer(const void *buffer, size_t size, bool write);
 static void unpin_buffer(const void *buffer, size_t size);
 #endif
 
@@ -162,6 +165,10 @@ syscall_handler(struct intr_frame *f)
     }
 
 #ifdef VM
+    case SYS_FORK:
+      f->eax = (uint32_t) process_fork(f);
+      break;
+
     case SYS_MMAP: {
       int fd = (int) uarg(f, 1);
       void *addr = uarg_ptr(f, 2);
@@ -174,6 +181,28 @@ syscall_handler(struct intr_frame *f)
       sys_munmap(mapid);
       break;
     }
+
+    case SYS_MADVISE: {
+      void *addr = uarg_ptr(f, 1);
+      unsigned length = (unsigned) uarg(f, 2);
+      int advice = (int) uarg(f, 3);
+      f->eax = (uint32_t) sys_madvise(addr, length, advice);
+      break;
+    }
+
+    case SYS_MLOCK: {
+      void *addr = uarg_ptr(f, 1);
+      unsigned length = (unsigned) uarg(f, 2);
+      f->eax = (uint32_t) sys_mlock(addr, length);
+      break;
+    }
+
+    case SYS_MUNLOCK: {
+      void *addr = uarg_ptr(f, 1);
+      unsigned length = (unsigned) uarg(f, 2);
+      f->eax = (uint32_t) sys_munlock(addr, length);
+      break;
+    }
 #endif
 
     default:
@@ -223,7 +252,7 @@ sys_mmap(int fd, void *addr)
         return -1;
       
       /* Check if page is already in SPT */
-      if (spt_get_entry(&t->spt, page) != NULL)
+      if (spt_query(&t->spt, page, NULL))
         return -1;
     }
   
@@ -257,6 +286,63 @@ sys_munmap(mapid_t mapid)
   
   mmap_unmap(mapid);
 }
+
+/* Pass a hint about how the LENGTH bytes at ADDR will be used */
+static int
+sys_madvise(void *addr, unsigned length, int advice)
+{
+  if (pg_ofs(addr) != 0 || advice < ADVICE_NORMAL || advice > ADVICE_DONTNEED)
+    return -1;
+  if (length == 0)
+    return 0;
+  if ((uintptr_t) addr + length < (uintptr_t) addr
+      || !is_user_vaddr(addr + length - 1))
+    return -1;
+
+  size_t page_cnt = (length + PGSIZE - 1) / PGSIZE;
+  return spt_advise(&thread_current()->spt, addr, page_cnt, advice) ? 0 : -1;
+}
+
+/* Find the pages holding the LENGTH bytes at ADDR, for mlock() and
+   munlock().  Returns false if the range is not in user space. */
+static bool
+lock_range(void *addr, unsigned length, void **upage, size_t *page_cnt)
+{
+  *upage = pg_round_down(addr);
+  *page_cnt = 0;
+  if (length == 0)
+    return true;
+  if ((uintptr_t) addr + length < (uintptr_t) addr
+      || !is_user_vaddr(addr + length - 1))
+    return false;
+  *page_cnt = (pg_round_up(addr + length) - *upage) / PGSIZE;
+  return true;
+}
+
+/* Hold the pages of the LENGTH bytes at ADDR in memory */
+static int
+sys_mlock(void *addr, unsigned length)
+{
+  void *upage;
+  size_t page_cnt;
+
+  if (!lock_range(addr, length, &upage, &page_cnt))
+    return -1;
+  return spt_mlock(&thread_current()->spt, upage, page_cnt) ? 0 : -1;
+}
+
+/* Let the pages of the LENGTH bytes at ADDR be evicted again */
+static int
+sys_munlock(void *addr, unsigned length)
+{
+  void *upage;
+  size_t page_cnt;
+
+  if (!lock_range(addr, length, &upage, &page_cnt))
+    return -1;
+  spt_munlock(&thread_current()->spt, upage, page_cnt);
+  return 0;
+}
 #endif
 
 /* Remaining syscall implementations... */
@@ -266,7 +352,7 @@ static int sys_read (int fd, void *ubuf, unsigned size) {
   if (!valid_urange(ubuf, size, true)) sys_exit(-1);
 
 #ifdef VM
-  pin_buffer(ubuf, size);
+  if (!pin_buffer(ubuf, size, true)) return -1;
 #endif
 
   if (fd == 0) {
@@ -380,7 +466,7 @@ static int sys_write(int fd, const void *ubuf, unsigned size) {
   if (fd == 0) return -1;
 
 #ifdef VM
-  pin_buffer(ubuf, size);
+  if (!pin_buffer(ubuf, size, false)) return -1;
 #endif
 
   if (fd == 1) {
@@ -533,16 +619,16 @@ static bool valid_uaddr(const void *uaddr, bool writable) {
 
 #ifdef VM
   struct thread *t = thread_current();
-  struct spt_entry *entry = spt_get_entry(&t->spt, pg_round_down(uaddr));
+  bool entry_writable;
   
-  if (entry != NULL){
-    if (writable && !entry->writable) return false;
+  if (spt_query(&t->spt, pg_round_down(uaddr), &entry_writable)){
+    if (writable && !entry_writable) return false;
     return true;
   }
   void *esp = t->esp_on_syscall;
   if (uaddr >= (void*)((uint8_t*)PHYS_BASE - 8*1024*1024) && uaddr < PHYS_BASE) {
       if (uaddr >= (esp - 32)) {
-          if (spt_get_entry(&t->spt, pg_round_down(esp)) != NULL) {
+          if (spt_query(&t->spt, pg_round_down(esp), NULL)) {
              return true; 
           }
       }
@@ -660,28 +746,53 @@ static struct file *fd_get(int fd){
 }
 
 #ifdef VM
-static void pin_buffer(const void *buffer, size_t size) {
-  if (size == 0) return;
+/* Tries to pin a page before giving up.  Each retry means the page
+   was evicted again between loading and pinning it, or, for a page
+   to be written, that it was first given a frame of its own.  That
+   only happens this often when memory is thrashing, and then it is
+   better to fail the call than to spin. */
+#define PIN_TRIES 8
+
+/* Pin the pages of BUFFER, which a system call reads or, if WRITE,
+   writes while holding file_lock, so that touching them cannot
+   fault and evict a page that needs file_lock to be written back.
+   A page to be written first gets a frame of its own, so that the
+   write does not fault to copy it.  Returns false, with nothing
+   pinned, if a page cannot be pinned within PIN_TRIES tries. */
+static bool pin_buffer(const void *buffer, size_t size, bool write) {
+  if (size == 0) return true;
   
   struct thread *t = thread_current();
   const void *start = pg_round_down(buffer);
   const void *end = pg_round_down((const uint8_t *)buffer + size - 1);
   
   for (const void *page = start; page <= end; page += PGSIZE) {
-    void *kpage = pagedir_get_page(t->pagedir, page);
-    if (kpage == NULL) {
-      if (!spt_load_page(&t->spt, (void *)page)) {
+    bool pinned = false;
+
+    for (int tries = 0; !pinned && tries < PIN_TRIES; tries++) {
+      void *kpage = pagedir_get_page(t->pagedir, page);
+      if (kpage == NULL) {
+        spt_load_page(&t->spt, (void *)page);
         continue;
       }
-      kpage = pagedir_get_page(t->pagedir, page);
+      if (write && (spt_break_cow(&t->spt, (void *)page)
+                    || spt_load_page(&t->spt, (void *)page)))
+        continue;
+      if (frame_pin(kpage)) {
+        pinned = pagedir_get_page(t->pagedir, page) == kpage;
+        if (!pinned)
+          frame_unpin(kpage);
+      }
     }
-    
-    if (kpage != NULL) {
-      frame_pin(kpage);
+    if (!pinned) {
+      unpin_buffer(start, (const uint8_t *)page - (const uint8_t *)start);
+      return false;
     }
   }
+  return true;
 }
 
+/* Drop the pins that pin_buffer() took on BUFFER */
 static void unpin_buffer(const void *buffer, size_t size) {
   if (size == 0) return;
   
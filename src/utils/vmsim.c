@@ -0,0 +1,667 @@
+/* Replays a page reference trace recorded by the kernel's
+   "-vmtrace" option against several page replacement policies
+   and reports the number of page faults each would take.
+
+   The trace is written to the scratch disk, so run Pintos with
+   a disk that is kept afterward, e.g.
+       pintos --make-disk=trace.dsk --scratch-size=2 ... \
+         -- -vmtrace run 'page-merge-seq'
+       vmsim trace.dsk
+   vmsim finds the trace by scanning the file for its header.
+
+   The kernel's policies (clock, clock2, lru, 2q) are simulated as
+   the kernel implements them, from accessed bits only.  Two
+   baselines are simulated besides: opt, which evicts the page
+   used furthest in the future, and lru-exact, which evicts the
+   page used least recently, as the kernel's "lru" approximates. */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Must match src/vm/trace.h. */
+#define VMTRACE_MAGIC "PINTOS-VMTRACE1"
+#define SECTOR_SIZE 512
+
+struct vmtrace_header
+  {
+    char magic[16];
+    uint32_t frame_cnt;
+    uint32_t record_cnt;
+    uint32_t dropped_cnt;
+    char policy[16];
+  };
+
+struct vmtrace_record
+  {
+    uint32_t tid;
+    uint32_t page;
+  };
+
+/* Reference string: one key per reference. */
+static uint64_t *refs;
+static size_t ref_cnt;
+
+/* Number of frames in the traced kernel. */
+static size_t trace_frame_cnt;
+
+/* Index of the next reference to the same page as each
+   reference, or SIZE_MAX if there is none.  Used by opt. */
+static size_t *next_use;
+
+/* Hash table from 64-bit key to index, with linear probing. */
+struct table
+  {
+    uint64_t *keys;
+    size_t *values;
+    bool *used;
+    size_t mask;
+  };
+
+/* Replacement policies. */
+enum policy
+  {
+    OPT, LRU_EXACT, CLOCK, CLOCK2, LRU, TWOQ, POLICY_CNT
+  };
+
+static const char *policy_names[POLICY_CNT] =
+  {"opt", "lru-exact", "clock", "clock2", "lru", "2q"};
+
+/* A queue of frames, linked by index. */
+#define NIL SIZE_MAX
+struct queue
+  {
+    size_t head, tail, cnt;
+  };
+
+/* A page frame in a simulated memory. */
+struct frame
+  {
+    uint64_t key;               /* Resident page. */
+    bool accessed;              /* Accessed bit. */
+    bool ref;                   /* Access already seen by lru or 2q. */
+    size_t next_use;            /* For opt: next reference to page. */
+    struct queue *queue;        /* Queue holding the frame, if any. */
+    size_t prev, next;          /* Neighbors in QUEUE. */
+  };
+
+/* Ghost ring of recently evicted keys, for 2q. */
+struct ghost_ring
+  {
+    uint64_t *keys;
+    bool *used;
+    size_t cap, next, cnt;
+    struct table index;         /* Key to slot. */
+  };
+
+static void usage (void);
+static void read_trace (const char *file_name);
+static size_t simulate (enum policy, size_t frame_cnt);
+
+int
+main (int argc, char *argv[])
+{
+  size_t frame_cnt = 0;
+  int opt;
+  int i;
+
+  while ((opt = getopt (argc, argv, "f:h")) != -1)
+    switch (opt)
+      {
+      case 'f':
+        frame_cnt = strtoul (optarg, NULL, 0);
+        if (frame_cnt == 0)
+          usage ();
+        break;
+      default:
+        usage ();
+      }
+  if (optind + 1 != argc)
+    usage ();
+
+  read_trace (argv[optind]);
+  if (frame_cnt == 0)
+    frame_cnt = trace_frame_cnt;
+  if (frame_cnt == 0)
+    {
+      fprintf (stderr, "vmsim: trace records no frame count, use -f\n");
+      return EXIT_FAILURE;
+    }
+
+  printf ("%zu frames, %zu references\n", frame_cnt, ref_cnt);
+  printf ("%-9s %10s %8s\n", "policy", "faults", "rate");
+  for (i = 0; i < POLICY_CNT; i++)
+    {
+      size_t faults = simulate (i, frame_cnt);
+      printf ("%-9s %10zu %7.2f%%\n", policy_names[i], faults,
+              ref_cnt ? 100.0 * faults / ref_cnt : 0.0);
+    }
+  return EXIT_SUCCESS;
+}
+
+static void
+usage (void)
+{
+  fprintf (stderr,
+           "vmsim: replays a Pintos page reference trace\n"
+           "usage: vmsim [-f FRAMES] DISK\n"
+           "  where DISK is a disk or file holding the trace and\n"
+           "    FRAMES is the number of page frames to simulate,\n"
+           "    by default the number in the traced kernel.\n");
+  exit (EXIT_FAILURE);
+}
+
+static void *
+xcalloc (size_t n, size_t size)
+{
+  void *p = calloc (n ? n : 1, size);
+  if (p == NULL)
+    {
+      fprintf (stderr, "vmsim: out of memory\n");
+      exit (EXIT_FAILURE);
+    }
+  return p;
+}
+
+static void
+table_init (struct table *t, size_t min_size)
+{
+  size_t size = 16;
+  while (size < 2 * min_size)
+    size *= 2;
+  t->keys = xcalloc (size, sizeof *t->keys);
+  t->values = xcalloc (size, sizeof *t->values);
+  t->used = xcalloc (size, sizeof *t->used);
+  t->mask = size - 1;
+}
+
+static void
+table_destroy (struct table *t)
+{
+  free (t->keys);
+  free (t->values);
+  free (t->used);
+}
+
+static size_t
+table_hash (const struct table *t, uint64_t key)
+{
+  key *= 0x9e3779b97f4a7c15ull;
+  return (key >> 32) & t->mask;
+}
+
+/* Returns the slot holding KEY, or the empty slot where it
+   belongs. */
+static size_t
+table_slot (const struct table *t, uint64_t key)
+{
+  size_t i = table_hash (t, key);
+  while (t->used[i] && t->keys[i] != key)
+    i = (i + 1) & t->mask;
+  return i;
+}
+
+static bool
+table_get (const struct table *t, uint64_t key, size_t *value)
+{
+  size_t i = table_slot (t, key);
+  if (!t->used[i])
+    return false;
+  *value = t->values[i];
+  return true;
+}
+
+static void
+table_put (struct table *t, uint64_t key, size_t value)
+{
+  size_t i = table_slot (t, key);
+  t->used[i] = true;
+  t->keys[i] = key;
+  t->values[i] = value;
+}
+
+/* Deletes KEY, moving later entries of its probe sequence back
+   so that lookups need no tombstones. */
+static void
+table_delete (struct table *t, uint64_t key)
+{
+  size_t i = table_slot (t, key);
+  size_t j;
+
+  if (!t->used[i])
+    return;
+  t->used[i] = false;
+  for (j = (i + 1) & t->mask; t->used[j]; j = (j + 1) & t->mask)
+    {
+      size_t home = table_hash (t, t->keys[j]);
+      bool movable = i <= j ? home <= i || home > j
+                            : home <= i && home > j;
+      if (movable)
+        {
+          t->used[i] = true;
+          t->keys[i] = t->keys[j];
+          t->values[i] = t->values[j];
+          t->used[j] = false;
+          i = j;
+        }
+    }
+}
+
+/* Reads the trace from FILE_NAME into REFS, and computes
+   NEXT_USE. */
+static void
+read_trace (const char *file_name)
+{
+  static unsigned char sector[SECTOR_SIZE];
+  struct vmtrace_header h;
+  struct table last_use;
+  FILE *file;
+  size_t i;
+
+  file = fopen (file_name, "rb");
+  if (file == NULL)
+    {
+      fprintf (stderr, "vmsim: %s: %s\n", file_name, strerror (errno));
+      exit (EXIT_FAILURE);
+    }
+
+  /* Find the header. */
+  for (;;)
+    {
+      if (fread (sector, SECTOR_SIZE, 1, file) != 1)
+        {
+          fprintf (stderr, "vmsim: %s: no trace found\n", file_name);
+          exit (EXIT_FAILURE);
+        }
+      if (!memcmp (sector, VMTRACE_MAGIC, sizeof VMTRACE_MAGIC))
+        break;
+    }
+  memcpy (&h, sector, sizeof h);
+  h.policy[sizeof h.policy - 1] = '\0';
+  printf ("trace: %"PRIu32" records from %"PRIu32" frames under %s",
+          h.record_cnt, h.frame_cnt, h.policy);
+  if (h.dropped_cnt > 0)
+    printf (" (%"PRIu32" dropped)", h.dropped_cnt);
+  printf ("\n");
+
+  /* Read the records.  FAULT and REF records both count as one
+     reference to their page. */
+  refs = xcalloc (h.record_cnt, sizeof *refs);
+  for (ref_cnt = 0; ref_cnt < h.record_cnt; ref_cnt++)
+    {
+      struct vmtrace_record r;
+      if (fread (&r, sizeof r, 1, file) != 1)
+        {
+          fprintf (stderr, "vmsim: %s: trace truncated after %zu records\n",
+                   file_name, ref_cnt);
+          break;
+        }
+      refs[ref_cnt] = ((uint64_t) r.tid << 32)
+                      | (r.page & ~(uint32_t) 0xfff);
+    }
+  fclose (file);
+
+  /* Find each reference's next use by scanning backward. */
+  next_use = xcalloc (ref_cnt, sizeof *next_use);
+  table_init (&last_use, ref_cnt);
+  for (i = ref_cnt; i-- > 0; )
+    {
+      if (!table_get (&last_use, refs[i], &next_use[i]))
+        next_use[i] = SIZE_MAX;
+      table_put (&last_use, refs[i], i);
+    }
+  table_destroy (&last_use);
+
+  trace_frame_cnt = h.frame_cnt;
+}
+
+static void
+queue_init (struct queue *q)
+{
+  q->head = q->tail = NIL;
+  q->cnt = 0;
+}
+
+/* Removes frame I from its queue, if any. */
+static void
+queue_remove (struct frame *frames, size_t i)
+{
+  struct frame *f = &frames[i];
+  struct queue *q = f->queue;
+
+  if (q == NULL)
+    return;
+  if (f->prev != NIL)
+    frames[f->prev].next = f->next;
+  else
+    q->head = f->next;
+  if (f->next != NIL)
+    frames[f->next].prev = f->prev;
+  else
+    q->tail = f->prev;
+  q->cnt--;
+  f->queue = NULL;
+}
+
+/* Moves frame I to the tail of Q. */
+static void
+queue_push (struct frame *frames, size_t i, struct queue *q)
+{
+  struct frame *f = &frames[i];
+
+  queue_remove (frames, i);
+  f->queue = q;
+  f->prev = q->tail;
+  f->next = NIL;
+  if (q->tail != NIL)
+    frames[q->tail].next = i;
+  else
+    q->head = i;
+  q->tail = i;
+  q->cnt++;
+}
+
+static void
+ghost_init (struct ghost_ring *g, size_t cap)
+{
+  g->keys = xcalloc (cap, sizeof *g->keys);
+  g->used = xcalloc (cap, sizeof *g->used);
+  g->cap = cap;
+  g->next = g->cnt = 0;
+  table_init (&g->index, cap);
+}
+
+static void
+ghost_destroy (struct ghost_ring *g)
+{
+  free (g->keys);
+  free (g->used);
+  table_destroy (&g->index);
+}
+
+static bool ghost_take (struct ghost_ring *, uint64_t key);
+
+/* Remembers KEY, in place of the oldest key if G is full.  As in
+   the kernel, a key is remembered at most once. */
+static void
+ghost_add (struct ghost_ring *g, uint64_t key)
+{
+  ghost_take (g, key);
+  if (g->used[g->next])
+    table_delete (&g->index, g->keys[g->next]);
+  else
+    g->cnt++;
+  g->keys[g->next] = key;
+  g->used[g->next] = true;
+  table_put (&g->index, key, g->next);
+  g->next = (g->next + 1) % g->cap;
+}
+
+/* Forgets KEY if G remembers it.  Returns true if it did. */
+static bool
+ghost_take (struct ghost_ring *g, uint64_t key)
+{
+  size_t slot;
+
+  if (!table_get (&g->index, key, &slot))
+    return false;
+  table_delete (&g->index, key);
+  g->used[slot] = false;
+  g->cnt--;
+  return true;
+}
+
+/* State of one simulation run. */
+struct sim
+  {
+    struct frame *frames;
+    size_t frame_cnt;
+    size_t hand;                        /* Clock hand. */
+    size_t spread;                      /* clock2 hand spread. */
+    struct queue q[2];                  /* lru-exact: q[0];
+                                           lru: inactive, active;
+                                           2q: A1, Am. */
+    struct ghost_ring ghosts[2];        /* 2q: evicted from A1, Am. */
+    size_t a1_target;                   /* 2q: desired size of A1. */
+  };
+
+/* Scans 2Q queue WHICH for a victim as the kernel does, moving
+   pages accessed again to Am.  Returns NIL if none is found. */
+static size_t
+twoq_scan (struct sim *s, int which)
+{
+  size_t scans = s->q[which].cnt;
+
+  while (scans-- > 0)
+    {
+      size_t i = s->q[which].head;
+      struct frame *f = &s->frames[i];
+      if (!f->accessed)
+        {
+          ghost_add (&s->ghosts[which], f->key);
+          return i;
+        }
+      f->accessed = false;
+      if (which == 0 && !f->ref)
+        {
+          f->ref = true;
+          queue_push (s->frames, i, &s->q[0]);
+        }
+      else
+        queue_push (s->frames, i, &s->q[1]);
+    }
+  return NIL;
+}
+
+/* Demotes active lru pages, as the kernel does, until a third of
+   the pages are inactive. */
+static void
+lru_balance (struct sim *s)
+{
+  size_t scans = s->q[1].cnt;
+
+  while (scans-- > 0 && s->q[0].cnt * 3 < s->q[0].cnt + s->q[1].cnt)
+    {
+      size_t i = s->q[1].head;
+      struct frame *f = &s->frames[i];
+      if (f->accessed)
+        {
+          f->accessed = false;
+          queue_push (s->frames, i, &s->q[1]);
+        }
+      else
+        {
+          f->ref = false;
+          queue_push (s->frames, i, &s->q[0]);
+        }
+    }
+}
+
+/* Scans the inactive lru list for a victim as the kernel does,
+   promoting pages seen accessed twice.  Falls back to the first
+   frame, like the kernel's any_evictable(). */
+static size_t
+lru_scan (struct sim *s)
+{
+  size_t scans;
+
+  lru_balance (s);
+  scans = 2 * s->q[0].cnt;
+  while (scans-- > 0)
+    {
+      size_t i = s->q[0].head;
+      struct frame *f = &s->frames[i];
+      if (!f->accessed)
+        return i;
+      f->accessed = false;
+      if (!f->ref)
+        {
+          f->ref = true;
+          queue_push (s->frames, i, &s->q[0]);
+        }
+      else
+        queue_push (s->frames, i, &s->q[1]);
+    }
+  return 0;
+}
+
+/* Chooses a frame to replace under policy P. */
+static size_t
+choose_victim (struct sim *s, enum policy p)
+{
+  size_t n = s->frame_cnt;
+  size_t i, v;
+
+  switch (p)
+    {
+    case OPT:
+      v = 0;
+      for (i = 1; i < n; i++)
+        if (s->frames[i].next_use > s->frames[v].next_use)
+          v = i;
+      return v;
+
+    case LRU_EXACT:
+      return s->q[0].head;
+
+    case LRU:
+      return lru_scan (s);
+
+    case CLOCK:
+      for (;;)
+        {
+          struct frame *f = &s->frames[s->hand];
+          v = s->hand;
+          s->hand = (s->hand + 1) % n;
+          if (!f->accessed)
+            return v;
+          f->accessed = false;
+        }
+
+    case CLOCK2:
+      for (;;)
+        {
+          struct frame *back = &s->frames[(s->hand + n - s->spread) % n];
+          v = (s->hand + n - s->spread) % n;
+          s->frames[s->hand].accessed = false;
+          s->hand = (s->hand + 1) % n;
+          if (!back->accessed)
+            return v;
+          back->accessed = false;
+        }
+
+    case TWOQ:
+      v = NIL;
+      if (s->q[0].cnt > 0 && (s->q[0].cnt > s->a1_target || s->q[1].cnt == 0))
+        v = twoq_scan (s, 0);
+      if (v == NIL)
+        v = twoq_scan (s, 1);
+      if (v == NIL)
+        v = twoq_scan (s, 0);
+
+      /* Every page was accessed again: like the kernel's
+         any_evictable(), fall back to the first frame. */
+      return v != NIL ? v : 0;
+
+    default:
+      abort ();
+    }
+}
+
+/* Places the page referenced at time T in frame I under P. */
+static void
+install (struct sim *s, enum policy p, size_t i, size_t t)
+{
+  struct frame *f = &s->frames[i];
+  size_t step;
+
+  f->key = refs[t];
+  f->accessed = true;
+  f->next_use = next_use[t];
+  if (p == LRU_EXACT)
+    queue_push (s->frames, i, &s->q[0]);
+  else if (p == LRU)
+    {
+      f->ref = false;
+      queue_push (s->frames, i, &s->q[0]);
+    }
+  else if (p == TWOQ)
+    {
+      struct ghost_ring *g1 = &s->ghosts[0], *gm = &s->ghosts[1];
+
+      f->ref = false;
+      if (ghost_take (g1, f->key))
+        {
+          step = gm->cnt > g1->cnt + 1 ? gm->cnt / (g1->cnt + 1) : 1;
+          s->a1_target = s->a1_target + step < s->frame_cnt
+                         ? s->a1_target + step : s->frame_cnt;
+          queue_push (s->frames, i, &s->q[1]);
+        }
+      else if (ghost_take (gm, f->key))
+        {
+          step = g1->cnt > gm->cnt + 1 ? g1->cnt / (gm->cnt + 1) : 1;
+          s->a1_target = s->a1_target > step ? s->a1_target - step : 0;
+          queue_push (s->frames, i, &s->q[1]);
+        }
+      else
+        queue_push (s->frames, i, &s->q[0]);
+    }
+}
+
+/* Replays the trace in FRAME_CNT frames under policy P and
+   returns the number of faults. */
+static size_t
+simulate (enum policy p, size_t frame_cnt)
+{
+  struct sim s;
+  struct table resident;
+  size_t used = 0, faults = 0;
+  size_t t, i;
+
+  memset (&s, 0, sizeof s);
+  s.frames = xcalloc (frame_cnt, sizeof *s.frames);
+  s.frame_cnt = frame_cnt;
+  s.spread = frame_cnt / 4 > 0 ? frame_cnt / 4 : 1;
+  s.a1_target = frame_cnt / 4;
+  queue_init (&s.q[0]);
+  queue_init (&s.q[1]);
+  ghost_init (&s.ghosts[0], frame_cnt);
+  ghost_init (&s.ghosts[1], frame_cnt);
+  table_init (&resident, frame_cnt);
+
+  for (t = 0; t < ref_cnt; t++)
+    {
+      if (table_get (&resident, refs[t], &i))
+        {
+          struct frame *f = &s.frames[i];
+          f->accessed = true;
+          f->next_use = next_use[t];
+          if (p == LRU_EXACT)
+            queue_push (s.frames, i, &s.q[0]);
+          continue;
+        }
+
+      faults++;
+      if (used < frame_cnt)
+        i = used++;
+      else
+        {
+          i = choose_victim (&s, p);
+          table_delete (&resident, s.frames[i].key);
+          queue_remove (s.frames, i);
+        }
+      install (&s, p, i, t);
+      table_put (&resident, refs[t], i);
+    }
+
+  table_destroy (&resident);
+  ghost_destroy (&s.ghosts[0]);
+  ghost_destroy (&s.ghosts[1]);
+  free (s.frames);
+  return faults;
+}
@@ -1,4 +1,6 @@
 #include "vm/frame.h"
+#include <round.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/malloc.h"
@@ -7,28 +9,182 @@
 #include "threads/vaddr.h"
 #include "userprog/pagedir.h"
 #include "filesys/file.h"
+#include "filesys/inode.h"
 #include "vm/page.h"
 #include "vm/swap.h"
 #include "userprog/syscall.h"
 #include "threads/interrupt.h"
+#include "devices/timer.h"
+#include "vm/trace.h"
 
-static struct list frame_table;     /* List of all frames */
+/* Frame table.  There is one entry for every page of the user
+   pool, so the entry for a frame is found by its page number
+   rather than by searching.
+
+   frame_lock protects the table, the replacement policy and the
+   counters below, but is never held across I/O.  A frame that is
+   being filled by frame_alloc()'s caller, or drained by
+   evict_frame(), is marked busy so that no one else touches it.
+   Code that holds a supplemental page table lock may acquire
+   frame_lock, so evict_frame() only ever tries to take an SPT
+   lock while holding frame_lock. */
+static struct frame_entry *frame_table; /* Array of frame_cnt entries */
+static size_t frame_cnt;            /* Number of frames in user pool */
+static uint8_t *frame_base;         /* Kernel address of frame 0 */
 static struct lock frame_lock;      /* Lock for frame table */
-static struct list_elem *clock_hand;/* Clock hand for eviction algorithm */
+static struct condition evict_unwaited; /* An SPT's evict_waiters hit 0 */
+
+/* Page cache: frames holding read-only file pages, keyed by file
+   and offset, so that processes running the same program share
+   its text.  A frame stays cached while anyone maps it.
+
+   Frames are also shared, without being cached, by a process and
+   the children it fork()s.  Those copy-on-write pages are mapped
+   read-only, and a write gives the writer a copy of its own. */
+static struct hash page_cache;
+
+/* Frames holding pages that a process reading a range sequentially,
+   as told by madvise(), has moved past.  They are evicted before
+   the replacement policy is asked for a victim, unless touched
+   again since. */
+static struct list consumed_list;
+
+/* A mapping of a shared frame besides its owner's */
+struct frame_sharer
+{
+  struct thread *thread;      /* Mapping process */
+  void *upage;                /* Where it maps the frame */
+  bool pinned;                /* Whether this mapping is pinned */
+  struct list_elem elem;      /* Element in frame_entry's sharers */
+  struct frame_sharer *next;  /* Next in an eviction's sharers */
+};
+
+/* Replacement policies, selectable by name */
+static const struct frame_policy *const frame_policies[] =
+  {
+    &frame_policy_clock,
+    &frame_policy_clock2,
+    &frame_policy_2q,
+    &frame_policy_lru,
+  };
+const char *frame_policy_name = "clock";
+static const struct frame_policy *policy;
+
+/* Page-out daemon.  When fewer than pageout_low frames are left in
+   the user pool, frame_alloc() wakes the daemon, which evicts
+   pages until pageout_high frames are free.  The writeback then
+   happens in the daemon rather than in a faulting process, which
+   usually gets its frame straight from palloc_get_page(). */
+static size_t frame_free_cnt;       /* Frames left in the user pool */
+static size_t pageout_low;          /* Wake the daemon below this */
+static size_t pageout_high;         /* Daemon reclaims up to this */
+static struct semaphore pageout_sema; /* Upped to wake the daemon */
+static bool pageout_running;        /* Daemon woken and not done yet */
+
+/* Statistics */
+static long long frame_allocs;      /* # of frames handed out */
+static long long frame_evictions;   /* # of frames taken by eviction */
+static long long pageout_reclaims;  /* # of those freed by the daemon */
+static long long readahead_pages;   /* # of pages read ahead from swap */
+static long long readahead_hits;    /* # of those later accessed */
+static long long readahead_misses;  /* # of those freed unaccessed */
+static long long around_pages;      /* # of file pages faulted around */
+static long long around_hits;       /* # of those later accessed */
+static long long around_misses;     /* # of those freed unaccessed */
+static long long page_cache_hits;   /* # of faults served by sharing */
+static long long swap_cache_hits;   /* # of evictions to a cached slot */
+static long long file_drops;        /* # of clean file pages dropped */
+static long long zero_evictions;    /* # of all-zero pages dropped */
+static long long zero_maps;         /* # of mappings of zero_page */
+static size_t locked_frames;        /* # of frames locked by mlock() */
+
+/* A page of zeros, mapped read-only in place of untouched zero
+   pages until they are first written.  It is not in the user pool,
+   so it is never evicted. */
+static void *zero_page;
+
+/* Trace sampling: every VMTRACE_SAMPLE_TICKS, the accessed bits
+   of all resident pages are logged and cleared on the next
+   frame allocation. */
+#define VMTRACE_SAMPLE_TICKS 4
+static int64_t last_sample;
 
 static struct frame_entry *find_frame(void *kpage);
+/* A page eviction in progress */
+struct eviction
+{
+  struct frame_entry *frame;  /* Victim frame, busy */
+  struct thread *owner;       /* Thread the page belongs to */
+  void *upage;                /* User address of the page */
+  struct spt_entry *spt_entry;  /* Its SPT entry, NULL if none */
+  bool dirty;                 /* Page was dirty */
+  bool to_swap;               /* Page must be written to swap */
+  bool zero;                  /* Page held only zeros */
+  size_t swap_slot;           /* Swap slot, once written */
+  size_t stale_slot;          /* Slot with an out-of-date copy */
+  struct frame_sharer *sharers; /* Copy-on-write sharers of the page */
+};
+
 static void *evict_frame(void);
+static bool evict_begin(struct eviction *);
+static void evict_write(struct eviction *);
+static void evict_finish(struct eviction *);
+static int eviction_less(const void *, const void *);
+static void frame_sample(void);
+static void readahead_account(struct frame_entry *, bool accessed);
+static struct frame_entry *consumed_victim(void);
+static void unconsume(struct frame_entry *);
+static bool page_is_zero(const void *kpage);
+static struct thread *lock_sharers(struct frame_entry *);
+static void wait_spt(struct thread *);
+static void unmap_sharers(struct frame_entry *);
+static bool take_sharers(struct eviction *);
+static void finish_sharer(struct eviction *, struct frame_sharer *);
+static void uncache(struct frame_entry *);
+static hash_hash_func cache_hash;
+static hash_less_func cache_less;
+static void pageout_daemon(void *aux);
 
 /* Initialize the frame table */
 void 
 frame_init(void)
 {
-  list_init(&frame_table);
+  size_t i;
+
+  for (i = 0; i < sizeof frame_policies / sizeof *frame_policies; i++)
+    if (!strcmp(frame_policies[i]->name, frame_policy_name))
+      policy = frame_policies[i];
+  if (policy == NULL)
+    PANIC("unknown page replacement policy `%s'", frame_policy_name);
+
+  frame_cnt = palloc_user_pages((void **) &frame_base);
+  frame_table = palloc_get_multiple(PAL_ASSERT | PAL_ZERO,
+                                    DIV_ROUND_UP(frame_cnt * sizeof *frame_table,
+                                                 PGSIZE));
+  for (i = 0; i < frame_cnt; i++)
+    {
+      frame_table[i].kpage = frame_base + i * PGSIZE;
+      cond_init(&frame_table[i].io_done);
+      list_init(&frame_table[i].sharers);
+    }
   lock_init(&frame_lock);
-  clock_hand = NULL;
+  cond_init(&evict_unwaited);
+  hash_init(&page_cache, cache_hash, cache_less, NULL);
+  list_init(&consumed_list);
+  zero_page = palloc_get_page(PAL_ASSERT | PAL_ZERO);
+  policy->init(frame_cnt);
+  vmtrace_init(frame_cnt, policy->name);
+
+  frame_free_cnt = frame_cnt;
+  pageout_low = frame_cnt / 32 > 2 ? frame_cnt / 32 : 2;
+  pageout_high = 2 * pageout_low;
+  sema_init(&pageout_sema, 0);
+  thread_create("pageout", PRI_DEFAULT, pageout_daemon, NULL);
 }
 
-/* Allocate a frame */
+/* Allocate a frame for UPAGE of the current thread.  The frame
+   is busy, and so cannot be evicted, until the caller has filled
+   and mapped it and calls frame_done() */
 void *
 frame_alloc(enum palloc_flags flags, void *upage)
 {
@@ -36,7 +192,21 @@ frame_alloc(enum palloc_flags flags, void *upage)
   
   void *kpage = palloc_get_page(flags);
   
-  if (kpage == NULL)
+  if (kpage != NULL)
+    {
+      bool wake;
+
+      lock_acquire(&frame_lock);
+      frame_free_cnt--;
+      wake = frame_free_cnt < pageout_low && !pageout_running;
+      if (wake)
+        pageout_running = true;
+      lock_release(&frame_lock);
+
+      if (wake)
+        sema_up(&pageout_sema);
+    }
+  else
     {
       kpage = evict_frame();
       if (kpage == NULL)
@@ -46,198 +216,1058 @@ frame_alloc(enum palloc_flags flags, void *upage)
         memset(kpage, 0, PGSIZE);
     }
   
-  struct frame_entry *entry = malloc(sizeof(struct frame_entry));
-  if (entry == NULL)
-    {
-      palloc_free_page(kpage);
-      return NULL;
-    }
+  struct frame_entry *entry = find_frame(kpage);
   
-  entry->kpage = kpage;
+  lock_acquire(&frame_lock);
   entry->upage = upage;
   entry->owner = thread_current();
   entry->pinned = false;
+  entry->pin_cnt = 0;
+  entry->busy = true;
+  entry->referenced = false;
+  entry->readahead = READAHEAD_NONE;
+  policy->insert(entry);
+  frame_allocs++;
+  if (vmtrace_enabled)
+    {
+      vmtrace_record(VMTRACE_FAULT, thread_tid(), upage, false);
+      frame_sample();
+    }
+  lock_release(&frame_lock);
+
+  if (vmtrace_enabled)
+    vmtrace_flush(false);
   
-  enum intr_level old_level = intr_disable();
-  list_push_back(&frame_table, &entry->elem);
-  intr_set_level(old_level);
-  
   return kpage;
 }
 
+/* Allocate a frame to read UPAGE of the current thread into ahead
+   of need, for readahead of KIND.  Returns NULL, without evicting
+   anything, unless more than pageout_high frames are free, so that
+   readahead never pushes out pages in use.  Like frame_alloc(), the
+   frame is busy until frame_done() */
+void *
+frame_alloc_readahead(void *upage, enum frame_readahead kind)
+{
+  struct frame_entry *entry;
+  void *kpage;
+
+  lock_acquire(&frame_lock);
+  if (frame_free_cnt <= pageout_high)
+    {
+      lock_release(&frame_lock);
+      return NULL;
+    }
+  frame_free_cnt--;
+  lock_release(&frame_lock);
+
+  kpage = palloc_get_page(PAL_USER);
+  lock_acquire(&frame_lock);
+  if (kpage == NULL)
+    frame_free_cnt++;
+  else
+    {
+      entry = find_frame(kpage);
+      entry->upage = upage;
+      entry->owner = thread_current();
+      entry->pinned = false;
+      entry->pin_cnt = 0;
+      entry->busy = true;
+      entry->referenced = false;
+      entry->readahead = kind;
+      policy->insert(entry);
+      if (kind == READAHEAD_FILE)
+        around_pages++;
+      else
+        readahead_pages++;
+    }
+  lock_release(&frame_lock);
+  return kpage;
+}
+
+/* Looks up the page READ_BYTES long at offset OFS in FILE in the
+   page cache.  If it is there, makes the current thread a sharer
+   of its frame, to map at UPAGE, and returns the frame, which is
+   busy until frame_done().  Otherwise returns NULL. */
+void *
+frame_share(struct file *file, off_t ofs, uint32_t read_bytes, void *upage)
+{
+  struct frame_sharer *s = malloc(sizeof *s);
+  struct frame_entry key, *e;
+  struct hash_elem *found;
+
+  if (s == NULL)
+    return NULL;
+  key.cache_sector = inode_get_inumber(file_get_inode(file));
+  key.cache_ofs = ofs;
+  key.cache_bytes = read_bytes;
+
+  lock_acquire(&frame_lock);
+  for (;;)
+    {
+      found = hash_find(&page_cache, &key.cache_elem);
+      if (found == NULL)
+        {
+          lock_release(&frame_lock);
+          free(s);
+          return NULL;
+        }
+      e = hash_entry(found, struct frame_entry, cache_elem);
+      if (!e->busy)
+        break;
+
+      /* Still being read, or being evicted */
+      cond_wait(&e->io_done, &frame_lock);
+    }
+  e->busy = true;
+  s->thread = thread_current();
+  s->pinned = false;
+  s->upage = upage;
+  list_push_back(&e->sharers, &s->elem);
+  page_cache_hits++;
+  lock_release(&frame_lock);
+  return e->kpage;
+}
+
+/* Enters frame KPAGE, busy and just filled with the page
+   READ_BYTES long at offset OFS in FILE, into the page cache,
+   unless another process has cached the same page meanwhile */
+void
+frame_cache(void *kpage, struct file *file, off_t ofs, uint32_t read_bytes)
+{
+  struct frame_entry *e = find_frame(kpage);
+
+  lock_acquire(&frame_lock);
+  e->cache_sector = inode_get_inumber(file_get_inode(file));
+  e->cache_ofs = ofs;
+  e->cache_bytes = read_bytes;
+  e->cached = hash_insert(&page_cache, &e->cache_elem) == NULL;
+  lock_release(&frame_lock);
+}
+
+/* Returns true if more than pageout_high frames are free, so that
+   a page can be loaded ahead of need without evicting another */
+bool
+frame_spare(void)
+{
+  bool spare;
+
+  lock_acquire(&frame_lock);
+  spare = frame_free_cnt > pageout_high;
+  lock_release(&frame_lock);
+  return spare;
+}
+
+/* Marks frame KPAGE, mapped by the current thread alone, as holding
+   a page it is done with, to be evicted ahead of others unless it
+   is touched again.  Its accessed bit is cleared to tell. */
+void
+frame_consumed(void *kpage)
+{
+  struct frame_entry *entry = find_frame(kpage);
+
+  lock_acquire(&frame_lock);
+  if (entry->owner == thread_current() && !entry->busy && entry->pin_cnt == 0
+      && entry->lock_cnt == 0 && !entry->consumed
+      && list_empty(&entry->sharers))
+    {
+      frame_test_and_clear_accessed(entry);
+      entry->consumed = true;
+      list_push_back(&consumed_list, &entry->consumed_elem);
+    }
+  lock_release(&frame_lock);
+}
+
+/* Returns the oldest consumed frame not touched since it was marked,
+   or NULL.  Frames touched again leave the list.  frame_lock must
+   be held. */
+static struct frame_entry *
+consumed_victim(void)
+{
+  while (!list_empty(&consumed_list))
+    {
+      struct frame_entry *e = list_entry(list_pop_front(&consumed_list),
+                                         struct frame_entry, consumed_elem);
+
+      e->consumed = false;
+      if (frame_evictable(e) && !frame_test_and_clear_accessed(e))
+        return e;
+    }
+  return NULL;
+}
+
+/* Takes E off the consumed list, if it is there.  frame_lock must
+   be held. */
+static void
+unconsume(struct frame_entry *e)
+{
+  if (e->consumed)
+    {
+      list_remove(&e->consumed_elem);
+      e->consumed = false;
+    }
+}
+
+/* Make frame KPAGE, returned by frame_alloc() or frame_share() and
+   now filled and mapped, available for eviction */
+void
+frame_done(void *kpage)
+{
+  struct frame_entry *e = find_frame(kpage);
+
+  lock_acquire(&frame_lock);
+  e->busy = false;
+  cond_broadcast(&e->io_done, &frame_lock);
+  lock_release(&frame_lock);
+}
+
+/* Wait until an eviction from frame KPAGE that was under way has
+   written the page out, so that the page's owner, or any process
+   sharing it, can read it back */
+void
+frame_wait(void *kpage)
+{
+  struct frame_entry *entry = find_frame(kpage);
+
+  lock_acquire(&frame_lock);
+  while (entry->busy && entry->evicting)
+    cond_wait(&entry->io_done, &frame_lock);
+  lock_release(&frame_lock);
+}
+
+/* Share frame KPAGE, mapped by the current thread, with thread T,
+   which is to map it at UPAGE, for fork().  The current thread's
+   page table lock must be held, keeping the frame from eviction. */
+bool
+frame_fork(void *kpage, struct thread *t, void *upage)
+{
+  struct frame_entry *entry = find_frame(kpage);
+  struct frame_sharer *s = malloc(sizeof *s);
+
+  if (s == NULL)
+    return false;
+  s->thread = t;
+  s->pinned = false;
+  s->upage = upage;
+  lock_acquire(&frame_lock);
+  list_push_back(&entry->sharers, &s->elem);
+  lock_release(&frame_lock);
+  return true;
+}
+
+/* Returns true if more than one process maps frame KPAGE */
+bool
+frame_shared(void *kpage)
+{
+  struct frame_entry *entry = find_frame(kpage);
+  bool shared;
+
+  lock_acquire(&frame_lock);
+  shared = !list_empty(&entry->sharers);
+  lock_release(&frame_lock);
+  return shared;
+}
+
+/* Free frame KPAGE, or, if it is shared, remove the current
+   thread's mapping of it */
 void 
 frame_free(void *kpage)
 {
-  enum intr_level old_level = intr_disable();
-  
   struct frame_entry *entry = find_frame(kpage);
-  if (entry != NULL)
+  
+  lock_acquire(&frame_lock);
+  if (!list_empty(&entry->sharers))
     {
-      if (clock_hand == &entry->elem)
+      struct frame_sharer *s = NULL;
+      struct list_elem *e;
+
+      if (entry->owner == thread_current())
         {
-          clock_hand = list_next(clock_hand);
-          if (clock_hand == list_end(&frame_table))
-            clock_hand = list_begin(&frame_table);
+          /* Hand the frame to another sharer */
+          s = list_entry(list_front(&entry->sharers),
+                         struct frame_sharer, elem);
+          if (entry->pinned)
+            entry->pin_cnt--;
+          entry->owner = s->thread;
+          entry->upage = s->upage;
+          entry->pinned = s->pinned;
+          s->pinned = false;
         }
-      
-      list_remove(&entry->elem);
-      free(entry);
+      else
+        for (e = list_begin(&entry->sharers); e != list_end(&entry->sharers);
+             e = list_next(e))
+          if (list_entry(e, struct frame_sharer, elem)->thread
+              == thread_current())
+            {
+              s = list_entry(e, struct frame_sharer, elem);
+              break;
+            }
+      ASSERT(s != NULL);
+      if (s->pinned)
+        entry->pin_cnt--;
+      list_remove(&s->elem);
+      lock_release(&frame_lock);
+      free(s);
+      return;
     }
-  
-  intr_set_level(old_level);
+  uncache(entry);
+  unconsume(entry);
+  if (entry->owner != NULL)
+    {
+      policy->remove(entry);
+      readahead_account(entry, pagedir_is_accessed(entry->owner->pagedir,
+                                                   entry->upage));
+    }
+  ASSERT(entry->lock_cnt == 0);
+  entry->owner = NULL;
+  entry->upage = NULL;
+  entry->pinned = false;
+  entry->pin_cnt = 0;
+  entry->busy = false;
+  frame_free_cnt++;
+  lock_release(&frame_lock);
   
   palloc_free_page(kpage);
 }
 
-/* Pin a frame (prevent eviction) */
-void 
+/* Waits until no eviction is waiting for SPT's lock, so that the
+   page table can be freed.  Called by spt_destroy() once the
+   table's frames are gone. */
+void
+frame_release_spt(struct spt *spt)
+{
+  lock_acquire(&frame_lock);
+  while (spt->evict_waiters > 0)
+    cond_wait(&evict_unwaited, &frame_lock);
+  lock_release(&frame_lock);
+}
+
+/* Map the shared zero page read-only at UPAGE of the current
+   thread */
+bool
+frame_map_zero(void *upage)
+{
+  if (!pagedir_set_page(thread_current()->pagedir, upage, zero_page, false))
+    return false;
+  lock_acquire(&frame_lock);
+  zero_maps++;
+  lock_release(&frame_lock);
+  return true;
+}
+
+/* Returns the pin flag of the current thread's mapping of ENTRY,
+   its owner's or a sharer's, or NULL if it does not map ENTRY.
+   frame_lock must be held. */
+static bool *
+pin_flag(struct frame_entry *entry)
+{
+  struct list_elem *e;
+
+  if (entry->owner == thread_current())
+    return &entry->pinned;
+  for (e = list_begin(&entry->sharers); e != list_end(&entry->sharers);
+       e = list_next(e))
+    {
+      struct frame_sharer *s = list_entry(e, struct frame_sharer, elem);
+      if (s->thread == thread_current())
+        return &s->pinned;
+    }
+  return NULL;
+}
+
+/* Pin the current thread's mapping of a frame, which keeps the
+   frame from eviction until frame_unpin().  Every process that
+   pins a shared frame holds its own pin.  Fails if the current
+   thread does not map the frame or it is being evicted.  The zero
+   page needs no pinning. */
+bool
 frame_pin(void *kpage)
 {
+  struct frame_entry *entry;
+  bool *pinned;
+  bool success;
+
+  if (kpage == zero_page)
+    return true;
+  entry = find_frame(kpage);
   lock_acquire(&frame_lock);
-  
-  struct frame_entry *entry = find_frame(kpage);
-  if (entry != NULL)
-    entry->pinned = true;
-  
+  pinned = pin_flag(entry);
+  success = pinned != NULL && !entry->busy;
+  if (success && !*pinned)
+    {
+      *pinned = true;
+      entry->pin_cnt++;
+    }
   lock_release(&frame_lock);
+  return success;
 }
 
-/* Unpin a frame (allow eviction) */
+/* Drop the current thread's pin on a frame, if it holds one.  Pins
+   of other processes sharing the frame stay. */
 void 
 frame_unpin(void *kpage)
 {
+  struct frame_entry *entry;
+  bool *pinned;
+
+  if (kpage == zero_page)
+    return;
+  entry = find_frame(kpage);
   lock_acquire(&frame_lock);
-  
+  pinned = pin_flag(entry);
+  if (pinned != NULL && *pinned)
+    {
+      *pinned = false;
+      entry->pin_cnt--;
+    }
+  lock_release(&frame_lock);
+}
+
+/* Lock frame KPAGE, which the current thread maps, in memory for
+   mlock().  The caller must hold its SPT lock, with the page loaded
+   and not in transit, so that no eviction of the frame can be under
+   way.  Every process that locks a shared frame holds a lock on it.
+   Fails if that would leave fewer than half the frames evictable. */
+bool
+frame_mlock(void *kpage)
+{
   struct frame_entry *entry = find_frame(kpage);
-  if (entry != NULL)
-    entry->pinned = false;
-  
+  bool success;
+
+  lock_acquire(&frame_lock);
+  success = entry->lock_cnt > 0 || locked_frames < frame_cnt / 2;
+  if (success && entry->lock_cnt++ == 0)
+    {
+      locked_frames++;
+      unconsume(entry);
+    }
   lock_release(&frame_lock);
+  return success;
 }
 
-/* Find frame entry by kernel page address */
-static struct frame_entry *
-find_frame(void *kpage)
+/* Drop a lock on frame KPAGE taken by frame_mlock() */
+void
+frame_munlock(void *kpage)
 {
-  struct list_elem *e;
-  
-  for (e = list_begin(&frame_table); e != list_end(&frame_table); e = list_next(e))
+  struct frame_entry *entry = find_frame(kpage);
+
+  lock_acquire(&frame_lock);
+  ASSERT(entry->lock_cnt > 0);
+  if (--entry->lock_cnt == 0)
+    locked_frames--;
+  lock_release(&frame_lock);
+}
+
+/* Print paging statistics, and write out any buffered trace */
+void
+frame_print_stats(void)
+{
+  printf("Paging: %s policy, %zu frames, %lld allocations, "
+         "%lld evictions (%lld by pageout)\n",
+         policy != NULL ? policy->name : "no",
+         frame_cnt, frame_allocs, frame_evictions, pageout_reclaims);
+  if (readahead_pages > 0)
+    printf("Readahead: %lld pages, %lld hits, %lld misses\n",
+           readahead_pages, readahead_hits, readahead_misses);
+  if (around_pages > 0)
+    printf("Fault-around: %lld pages, %lld faults avoided, %lld misses\n",
+           around_pages, around_hits, around_misses);
+  printf("Clean evictions: %lld file pages dropped, "
+         "%lld pages left in their swap slots\n",
+         file_drops, swap_cache_hits);
+  printf("Page cache: %zu pages, %lld faults served from it\n",
+         hash_size(&page_cache), page_cache_hits);
+  printf("Zero pages: %lld dropped on eviction, %lld shared mappings\n",
+         zero_evictions, zero_maps);
+  if (locked_frames > 0)
+    printf("Locked: %zu frames held in memory by mlock()\n", locked_frames);
+  swap_print_stats();
+  if (vmtrace_enabled && intr_get_level() == INTR_ON && !intr_context())
     {
-      struct frame_entry *entry = list_entry(e, struct frame_entry, elem);
-      if (entry->kpage == kpage)
-        return entry;
+      vmtrace_flush(true);
+      vmtrace_print_stats();
     }
-  
-  return NULL;
 }
 
-/* Evict a frame using clock algorithm */
-static void *
-evict_frame(void)
+/* Returns the number of frames in the frame table */
+size_t
+frame_count(void)
 {
-  enum intr_level old_level = intr_disable();
-  
-  if (list_empty(&frame_table))
+  return frame_cnt;
+}
+
+/* Returns the frame table entry with index IDX */
+struct frame_entry *
+frame_at(size_t idx)
+{
+  ASSERT(idx < frame_cnt);
+  return &frame_table[idx];
+}
+
+/* Returns true if E holds a user page that may be evicted */
+bool
+frame_evictable(const struct frame_entry *e)
+{
+  return e->owner != NULL && e->pin_cnt == 0 && e->lock_cnt == 0 && !e->busy;
+}
+
+/* Returns whether E's page was accessed since the last call, by
+   any process sharing it, and clears its accessed bits.  Accesses
+   seen by trace sampling count too. */
+bool
+frame_test_and_clear_accessed(struct frame_entry *e)
+{
+  uint32_t *pd = e->owner->pagedir;
+  bool accessed = e->referenced || pagedir_is_accessed(pd, e->upage);
+  struct list_elem *l;
+
+  e->referenced = false;
+  pagedir_set_accessed(pd, e->upage, false);
+  for (l = list_begin(&e->sharers); l != list_end(&e->sharers);
+       l = list_next(l))
     {
-      intr_set_level(old_level);
-      return NULL;
+      struct frame_sharer *s = list_entry(l, struct frame_sharer, elem);
+
+      if (pagedir_is_accessed(s->thread->pagedir, s->upage))
+        {
+          accessed = true;
+          pagedir_set_accessed(s->thread->pagedir, s->upage, false);
+        }
     }
-  
-  if (clock_hand == NULL || clock_hand == list_end(&frame_table))
-    clock_hand = list_begin(&frame_table);
-  
-  struct frame_entry *victim = NULL;
-  size_t iterations = 0;
-  size_t max_iterations = list_size(&frame_table) * 2;
-  
-  while (iterations < max_iterations)
+  if (accessed)
+    readahead_account(e, true);
+  return accessed;
+}
+
+/* Counts a readahead hit for E if it was ACCESSED, or else a miss
+   if E is leaving memory, the first time either happens.  A hit on
+   a page faulted around is a page fault avoided. */
+static void
+readahead_account(struct frame_entry *e, bool accessed)
+{
+  if (e->readahead == READAHEAD_NONE)
+    return;
+  if (e->readahead == READAHEAD_FILE)
     {
-      struct frame_entry *entry = list_entry(clock_hand, struct frame_entry, elem);
-      
-      if (!entry->pinned)
+      if (accessed)
+        around_hits++;
+      else
+        around_misses++;
+    }
+  else if (accessed)
+    readahead_hits++;
+  else
+    readahead_misses++;
+  e->readahead = READAHEAD_NONE;
+}
+
+/* Returns true if the page at KPAGE holds only zeros.  Most pages
+   that are not zero differ in the first few words, so the scan
+   usually stops early; otherwise it checks four words per
+   iteration. */
+static bool
+page_is_zero(const void *kpage)
+{
+  const uint32_t *p = kpage;
+  const uint32_t *end = p + PGSIZE / sizeof *p;
+
+  for (; p < end; p += 4)
+    if ((p[0] | p[1] | p[2] | p[3]) != 0)
+      return false;
+  return true;
+}
+
+/* Logs every resident page accessed since the previous sample to
+   the trace and clears its accessed bit, keeping a copy in the
+   frame entry for the replacement policy.  Runs at most once per
+   VMTRACE_SAMPLE_TICKS.  The frame table lock must be held. */
+static void
+frame_sample(void)
+{
+  int64_t now = timer_ticks();
+  size_t i;
+
+  if (now - last_sample < VMTRACE_SAMPLE_TICKS)
+    return;
+  last_sample = now;
+
+  for (i = 0; i < frame_cnt; i++)
+    {
+      struct frame_entry *e = &frame_table[i];
+      uint32_t *pd;
+
+      if (e->owner == NULL)
+        continue;
+      pd = e->owner->pagedir;
+      if (pagedir_is_accessed(pd, e->upage))
+        {
+          vmtrace_record(VMTRACE_REF, e->owner->tid, e->upage,
+                         pagedir_is_dirty(pd, e->upage));
+          pagedir_set_accessed(pd, e->upage, false);
+          e->referenced = true;
+        }
+    }
+}
+
+/* Page-out daemon: each time it is woken, evicts pages until
+   pageout_high frames are free or nothing more can be evicted.
+   Victims are taken up to SWAP_CLUSTER_MAX at a time and sorted by
+   owner and address, so each process's pages land in adjacent swap
+   slots and go out in a single write. */
+static void
+pageout_daemon(void *aux UNUSED)
+{
+  struct eviction evs[SWAP_CLUSTER_MAX];
+  void *kpages[SWAP_CLUSTER_MAX];
+  size_t slots[SWAP_CLUSTER_MAX];
+
+  for (;;)
+    {
+      sema_down(&pageout_sema);
+      lock_acquire(&frame_lock);
+      while (frame_free_cnt < pageout_high)
         {
-          uint32_t *pd = entry->owner->pagedir;
-          
-          if (pagedir_is_accessed(pd, entry->upage))
-            pagedir_set_accessed(pd, entry->upage, false);
-          else
+          size_t want = pageout_high - frame_free_cnt;
+          size_t n, swap_cnt, i;
+
+          lock_release(&frame_lock);
+          if (want > SWAP_CLUSTER_MAX)
+            want = SWAP_CLUSTER_MAX;
+          for (n = 0; n < want && evict_begin(&evs[n]); n++)
+            evict_write(&evs[n]);
+          if (n == 0)
             {
-              victim = entry;
+              lock_acquire(&frame_lock);
               break;
             }
+
+          qsort(evs, n, sizeof *evs, eviction_less);
+          swap_cnt = 0;
+          for (i = 0; i < n; i++)
+            if (evs[i].to_swap)
+              kpages[swap_cnt++] = evs[i].frame->kpage;
+          swap_out_cluster(kpages, swap_cnt, slots);
+
+          swap_cnt = 0;
+          for (i = 0; i < n; i++)
+            {
+              if (evs[i].to_swap)
+                evs[i].swap_slot = slots[swap_cnt++];
+              evict_finish(&evs[i]);
+
+              /* Free the page before counting it, and under
+                 frame_lock, so that frame_free_cnt never says more
+                 is free than palloc has, and frame_alloc() cannot
+                 take the page and count it gone first */
+              lock_acquire(&frame_lock);
+              evs[i].frame->busy = false;
+              palloc_free_page(evs[i].frame->kpage);
+              frame_free_cnt++;
+              pageout_reclaims++;
+              lock_release(&frame_lock);
+            }
+          lock_acquire(&frame_lock);
         }
-      
-      clock_hand = list_next(clock_hand);
-      if (clock_hand == list_end(&frame_table))
-        clock_hand = list_begin(&frame_table);
-      
-      iterations++;
+
+      /* Checked and cleared under frame_lock, so a frame_alloc()
+         that finds the daemon running is sure to be served */
+      pageout_running = false;
+      lock_release(&frame_lock);
     }
-  
-  if (victim == NULL)
+}
+
+/* Orders evictions by owner and then by user address */
+static int
+eviction_less(const void *a_, const void *b_)
+{
+  const struct eviction *a = a_, *b = b_;
+
+  if (a->owner != b->owner)
+    return a->owner->tid < b->owner->tid ? -1 : 1;
+  return a->upage < b->upage ? -1 : a->upage > b->upage;
+}
+
+/* Find frame entry by kernel page address */
+static struct frame_entry *
+find_frame(void *kpage)
+{
+  size_t idx = pg_no(kpage) - pg_no(frame_base);
+
+  ASSERT(pg_ofs(kpage) == 0);
+  ASSERT(idx < frame_cnt);
+  return &frame_table[idx];
+}
+
+/* Evict the frame chosen by the replacement policy and return
+   it, still busy, to the caller.  Returns NULL if every frame is
+   pinned or busy. */
+static void *
+evict_frame(void)
+{
+  struct eviction ev;
+
+  if (!evict_begin(&ev))
+    return NULL;
+  evict_write(&ev);
+  if (ev.to_swap)
+    ev.swap_slot = swap_out(ev.frame->kpage);
+  evict_finish(&ev);
+  return ev.frame->kpage;
+}
+
+/* Starts evicting the frame chosen by the replacement policy,
+   filling in EV.  Returns false if every frame is pinned or busy.
+
+   The victim is marked busy, and its SPT entry marked in transit
+   and its mapping removed under the owner's SPT lock.  The page is
+   then written out by evict_write() and, if EV->to_swap, the
+   caller, with no locks held, so that evictions by different
+   threads overlap.  An owner that faults on the page meanwhile
+   waits in frame_wait() until evict_finish(). */
+static bool
+evict_begin(struct eviction *ev)
+{
+  struct frame_entry *victim;
+  struct thread *user;
+  size_t tries = 0;
+
+  lock_acquire(&frame_lock);
+  for (;;)
     {
-      intr_set_level(old_level);
-      return NULL;
+      victim = consumed_victim();
+      if (victim == NULL)
+        victim = policy->victim();
+      if (victim == NULL)
+        {
+          lock_release(&frame_lock);
+          return false;
+        }
+      user = victim->owner;
+      if (rwlock_try_acquire_write(&user->spt.lock))
+        {
+          user = lock_sharers(victim);
+          if (user == NULL)
+            break;
+          rwlock_release_write(&victim->owner->spt.lock);
+        }
+
+      /* The owner, or a sharer, is using its page table, so pick
+         another page rather than wait with the frame table locked */
+      policy->requeue(victim);
+      if (++tries >= frame_cnt)
+        {
+          wait_spt(user);
+          tries = 0;
+        }
     }
+  policy->remove(victim);
+  unconsume(victim);
+  victim->busy = true;
+  victim->evicting = true;
+  frame_evictions++;
   
-  void *kpage = victim->kpage;
-  void *upage = victim->upage;
-  struct thread *owner = victim->owner;
-  uint32_t *pd = owner->pagedir;
-  bool dirty = pagedir_is_dirty(pd, upage);
-  
-  /* Clear page table entry first */
-  pagedir_clear_page(pd, upage);
-  
-  /* Move clock hand */
-  clock_hand = list_next(&victim->elem);
-  if (clock_hand == list_end(&frame_table))
-    clock_hand = list_begin(&frame_table);
-  
-  /* Remove from frame table */
-  list_remove(&victim->elem);
-  free(victim);
+  ev->frame = victim;
+  ev->owner = victim->owner;
+  ev->upage = victim->upage;
+  ev->to_swap = false;
+  ev->zero = false;
+  ev->stale_slot = SWAP_SLOT_NONE;
+  uint32_t *pd = ev->owner->pagedir;
+  readahead_account(victim, pagedir_is_accessed(pd, ev->upage));
   
-  /* Re-enable interrupts */
+  /* Unmap the page and mark it in transit, so the owner waits for
+     the write-out instead of reading a stale copy.  The owner must
+     not get to dirty the page between the dirty bit being read and
+     the mapping going away. */
+  enum intr_level old_level = intr_disable();
+  ev->dirty = pagedir_is_dirty(pd, ev->upage);
+  pagedir_clear_page(pd, ev->upage);
   intr_set_level(old_level);
-  
-  /* Update SPT */
-  struct spt_entry *spt_entry = spt_get_entry(&owner->spt, upage);
-  
-  if (spt_entry != NULL)
+  uncache(victim);
+  ev->spt_entry = spt_get_entry(&ev->owner->spt, ev->upage);
+  ev->sharers = NULL;
+  if (ev->spt_entry != NULL && ev->spt_entry->cow)
     {
-      lock_acquire(&owner->spt.lock);
-      
-      /* Mark as not loaded FIRST to prevent races */
-      spt_entry->loaded = false;
-      spt_entry->kpage = NULL;
-      
-      bool is_mmap = (spt_entry->type == PAGE_MMAP);
-      bool is_writable = spt_entry->writable;
-      struct file *file = spt_entry->file;
-      off_t file_offset = spt_entry->file_offset;
-      uint32_t read_bytes = spt_entry->read_bytes;
-      
-      lock_release(&owner->spt.lock);
-      
-      /* Now do I/O operations */
-      if (is_mmap && dirty)
+      /* A copy-on-write page can differ from its file although its
+         read-only mappings never show it dirty, so it is written
+         out unless every sharer's swap slot still holds it */
+      bool same_slot = take_sharers(ev);
+
+      ev->dirty = !same_slot || ev->spt_entry->swap_slot == SWAP_SLOT_NONE;
+    }
+  else
+    unmap_sharers(victim);
+  if (ev->spt_entry != NULL)
+    {
+      struct spt_entry *e = ev->spt_entry;
+
+      e->loaded = false;
+      e->in_transit = true;
+      if (e->swap_slot != SWAP_SLOT_NONE && !ev->dirty)
+        {
+          /* Its swap slot still holds the page */
+          swap_cache_hits++;
+        }
+      else
+        {
+          /* Only the dirty bit says whether the page must be kept:
+             a clean file page is read again from its file, and a
+             clean zero page is zeroed again.  A page whose swap
+             slot was reclaimed has no other copy, even if clean. */
+          ev->to_swap = e->type == PAGE_SWAP
+                        || (e->type != PAGE_MMAP && ev->dirty);
+          ev->stale_slot = e->swap_slot;
+          e->swap_slot = SWAP_SLOT_NONE;
+          if (e->type == PAGE_FILE && !ev->dirty)
+            file_drops++;
+        }
+    }
+  rwlock_release_write(&ev->owner->spt.lock);
+  lock_release(&frame_lock);
+
+  if (ev->stale_slot != SWAP_SLOT_NONE)
+    swap_free(ev->stale_slot);
+  return true;
+}
+
+/* Tries to take the page table lock of every sharer of E, for
+   evict_begin().  Returns NULL if it took them all, or else the
+   sharer whose lock is in use, holding none of them. */
+static struct thread *
+lock_sharers(struct frame_entry *e)
+{
+  struct list_elem *l, *m;
+
+  for (l = list_begin(&e->sharers); l != list_end(&e->sharers);
+       l = list_next(l))
+    {
+      struct thread *t = list_entry(l, struct frame_sharer, elem)->thread;
+
+      if (!rwlock_try_acquire_write(&t->spt.lock))
+        {
+          for (m = list_begin(&e->sharers); m != l; m = list_next(m))
+            rwlock_release_write(&list_entry(m, struct frame_sharer,
+                                             elem)->thread->spt.lock);
+          return t;
+        }
+    }
+  return NULL;
+}
+
+/* Waits for T's page table lock to be free, for evict_begin()
+   after a whole round of victims whose page tables were in use.
+   Blocking on the lock, rather than yielding, lets a lower
+   priority holder run, with our priority donated to it.
+   frame_lock must be held; it is released while waiting.
+
+   T maps a frame, so it has not yet freed its page table, and
+   counting us in evict_waiters keeps spt_destroy() from returning
+   until we are done with the lock. */
+static void
+wait_spt(struct thread *t)
+{
+  struct spt *spt = &t->spt;
+
+  spt->evict_waiters++;
+  lock_release(&frame_lock);
+  rwlock_acquire_write(&spt->lock);
+  rwlock_release_write(&spt->lock);
+  lock_acquire(&frame_lock);
+  if (--spt->evict_waiters == 0)
+    cond_broadcast(&evict_unwaited, &frame_lock);
+}
+
+/* Removes every sharer's mapping of E, which evict_begin() is
+   evicting, and releases the sharers' page table locks.  A shared
+   page is clean and read-only, so sharers can simply fault it in
+   again from its file. */
+static void
+unmap_sharers(struct frame_entry *e)
+{
+  while (!list_empty(&e->sharers))
+    {
+      struct frame_sharer *s = list_entry(list_pop_front(&e->sharers),
+                                          struct frame_sharer, elem);
+      struct spt_entry *se = spt_get_entry(&s->thread->spt, s->upage);
+
+      pagedir_clear_page(s->thread->pagedir, s->upage);
+      if (se != NULL)
+        {
+          se->loaded = false;
+          se->kpage = NULL;
+        }
+      rwlock_release_write(&s->thread->spt.lock);
+      free(s);
+    }
+}
+
+/* Removes the mappings of the copy-on-write page that EV is
+   evicting from all of its sharers, marking their entries in
+   transit as well, and releases the sharers' page table locks.
+   The sharers are left on EV for evict_finish().  Returns true if
+   every sharer's entry has the same swap slot as the owner's. */
+static bool
+take_sharers(struct eviction *ev)
+{
+  struct frame_entry *f = ev->frame;
+  bool same_slot = true;
+
+  while (!list_empty(&f->sharers))
+    {
+      struct frame_sharer *s = list_entry(list_pop_front(&f->sharers),
+                                          struct frame_sharer, elem);
+      struct spt_entry *se = spt_get_entry(&s->thread->spt, s->upage);
+
+      pagedir_clear_page(s->thread->pagedir, s->upage);
+      if (se != NULL)
+        {
+          se->loaded = false;
+          se->in_transit = true;
+          if (se->swap_slot != ev->spt_entry->swap_slot)
+            same_slot = false;
+        }
+      rwlock_release_write(&s->thread->spt.lock);
+      s->next = ev->sharers;
+      ev->sharers = s;
+    }
+  return same_slot;
+}
+
+/* Records where the page EV evicted went in the entry of sharer
+   S, as evict_finish() does for the owner.  A sharer whose page
+   went to swap gets a reference to the owner's slot. */
+static void
+finish_sharer(struct eviction *ev, struct frame_sharer *s)
+{
+  struct spt *spt = &s->thread->spt;
+  struct spt_entry *se;
+  size_t stale_slot = SWAP_SLOT_NONE;
+
+  rwlock_acquire_write(&spt->lock);
+  se = spt_get_entry(spt, s->upage);
+  if (se != NULL)
+    {
+      if (ev->to_swap || ev->zero)
         {
-          lock_acquire(&file_lock);
-          file_seek(file, file_offset);
-          file_write(file, kpage, read_bytes);
-          lock_release(&file_lock);
+          stale_slot = se->swap_slot;
+          se->swap_slot = SWAP_SLOT_NONE;
         }
-      else if (!is_mmap && (dirty || is_writable))
+      if (ev->to_swap)
         {
-          size_t swap_slot = swap_out(kpage);
-          
-          lock_acquire(&owner->spt.lock);
-          spt_entry->type = PAGE_SWAP;
-          spt_entry->swap_slot = swap_slot;
-          lock_release(&owner->spt.lock);
+          se->type = PAGE_SWAP;
+          se->swap_slot = ev->swap_slot;
+          swap_dup(ev->swap_slot);
         }
+      else if (ev->zero)
+        se->type = PAGE_ZERO;
+      se->kpage = NULL;
+      se->cow = false;
+      se->in_transit = false;
+    }
+  rwlock_release_write(&spt->lock);
+
+  if (stale_slot != SWAP_SLOT_NONE)
+    swap_free(stale_slot);
+}
+
+/* Removes E from the page cache, if it is there.  frame_lock must
+   be held. */
+static void
+uncache(struct frame_entry *e)
+{
+  if (e->cached)
+    {
+      hash_delete(&page_cache, &e->cache_elem);
+      e->cached = false;
+    }
+}
+
+static unsigned
+cache_hash(const struct hash_elem *e_, void *aux UNUSED)
+{
+  const struct frame_entry *e = hash_entry(e_, struct frame_entry, cache_elem);
+
+  return hash_int(e->cache_sector) ^ hash_int(e->cache_ofs);
+}
+
+static bool
+cache_less(const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct frame_entry *a = hash_entry(a_, struct frame_entry, cache_elem);
+  const struct frame_entry *b = hash_entry(b_, struct frame_entry, cache_elem);
+
+  if (a->cache_sector != b->cache_sector)
+    return a->cache_sector < b->cache_sector;
+  if (a->cache_ofs != b->cache_ofs)
+    return a->cache_ofs < b->cache_ofs;
+  return a->cache_bytes < b->cache_bytes;
+}
+
+/* Writes EV's page back to its file if it is a dirty mmapped
+   page.  Pages bound for swap are left to the caller, except that
+   a page of all zeros need not be kept at all. */
+static void
+evict_write(struct eviction *ev)
+{
+  struct spt_entry *e = ev->spt_entry;
+
+  if (ev->to_swap && page_is_zero(ev->frame->kpage))
+    {
+      ev->to_swap = false;
+      ev->zero = true;
+    }
+
+  /* The entry cannot change while it is in transit */
+  if (e != NULL && e->type == PAGE_MMAP && ev->dirty)
+    {
+      lock_acquire(&file_lock);
+      file_seek(e->file, e->file_offset);
+      file_write(e->file, ev->frame->kpage, e->read_bytes);
+      lock_release(&file_lock);
+    }
+}
+
+/* Finishes evicting EV, once its page has been written out.
+   Records where the page went in its SPT entry, takes the frame
+   away from its owner and wakes anyone waiting for the page.  The
+   frame stays busy for the caller to claim. */
+static void
+evict_finish(struct eviction *ev)
+{
+  struct frame_entry *victim = ev->frame;
+
+  if (ev->spt_entry != NULL)
+    {
+      rwlock_acquire_write(&ev->owner->spt.lock);
+      if (ev->to_swap)
+        {
+          ev->spt_entry->type = PAGE_SWAP;
+          ev->spt_entry->swap_slot = ev->swap_slot;
+          swap_set_owner(ev->swap_slot, &ev->owner->spt, ev->spt_entry);
+        }
+      else if (ev->zero)
+        ev->spt_entry->type = PAGE_ZERO;
+      ev->spt_entry->kpage = NULL;
+      ev->spt_entry->cow = false;
+      ev->spt_entry->in_transit = false;
+      rwlock_release_write(&ev->owner->spt.lock);
+    }
+  while (ev->sharers != NULL)
+    {
+      struct frame_sharer *s = ev->sharers;
+
+      ev->sharers = s->next;
+      finish_sharer(ev, s);
+      free(s);
     }
   
-  return kpage;
+  lock_acquire(&frame_lock);
+  if (ev->zero)
+    zero_evictions++;
+  victim->evicting = false;
+  victim->owner = NULL;
+  victim->upage = NULL;
+  cond_broadcast(&victim->io_done, &frame_lock);
+  lock_release(&frame_lock);
 }
@@ -1,33 +1,143 @@
 #ifndef VM_FRAME_H
 #define VM_FRAME_H
 
+#include <hash.h>
 #include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 
-/* Frame table entry */
-struct frame_entry 
+struct file;
+struct spt;
+
+/* How a frame came to be filled ahead of need */
+enum frame_readahead
+{
+  READAHEAD_NONE,           /* Filled for a fault on its own page */
+  READAHEAD_SWAP,           /* Read from swap with a faulting page */
+  READAHEAD_FILE            /* Read from a file around a faulting page */
+};
+
+/* Frame table entry, one per page of the user pool */
+struct frame_entry
 {
   void *kpage;              /* Kernel virtual address */
   void *upage;              /* User virtual address */
-  struct thread *owner;     /* Owning thread */
-  bool pinned;              /* Whether frame is pinned (cannot be evicted) */
-  struct list_elem elem;    /* List element for frame table */
+  struct thread *owner;     /* Owning thread, NULL if frame is free */
+  bool pinned;              /* Whether the owner's mapping is pinned */
+  unsigned pin_cnt;         /* Mappings pinned (cannot be evicted) */
+  unsigned lock_cnt;        /* Processes that mlock() it (cannot be evicted) */
+  bool busy;                /* Being filled or evicted (cannot be evicted) */
+  bool evicting;            /* Being evicted */
+  struct condition io_done; /* Signaled when an eviction finishes */
+  bool referenced;          /* Accessed bit saved by trace sampling */
+  enum frame_readahead readahead; /* Read ahead and not yet seen accessed */
+  bool consumed;            /* Passed by a sequential reader */
+  struct list_elem consumed_elem; /* Element in the consumed list */
+
+  /* Page cache of read-only file pages, which are shared by every
+     process that maps them.  OWNER and UPAGE are one mapping of a
+     shared frame, and SHARERS holds the others. */
+  struct list sharers;      /* List of struct frame_sharer */
+  bool cached;              /* In the page cache */
+  struct hash_elem cache_elem;  /* Element in the page cache */
+  block_sector_t cache_sector;  /* Inode sector of the file */
+  off_t cache_ofs;          /* Offset of the page in the file */
+  uint32_t cache_bytes;     /* Bytes of the page read from the file */
+
+  /* Owned by the replacement policy */
+  struct list_elem policy_elem; /* Element in one of the policy's lists */
+  int policy_list;          /* Which list policy_elem is in */
+  bool policy_ref;          /* Access already seen by the policy */
 };
 
+/* Page replacement policy.  All hooks run with the frame table
+   lock held.  If the frame victim() returns cannot be evicted after
+   all, requeue() puts it back where the next scan will reach it
+   last, keeping what the policy has learned about the page. */
+struct frame_policy
+{
+  const char *name;                         /* Name for -vmpolicy. */
+  void (*init) (size_t frame_cnt);          /* Set up, at boot. */
+  void (*insert) (struct frame_entry *);    /* Frame was mapped. */
+  void (*remove) (struct frame_entry *);    /* Frame was freed. */
+  struct frame_entry *(*victim) (void);     /* Choose a frame to evict. */
+  void (*requeue) (struct frame_entry *);   /* Victim was passed over. */
+};
+
+extern const struct frame_policy frame_policy_clock;
+extern const struct frame_policy frame_policy_clock2;
+extern const struct frame_policy frame_policy_2q;
+extern const struct frame_policy frame_policy_lru;
+
+/* Name of the replacement policy to use.
+   Controlled by kernel command-line option "-vmpolicy=NAME". */
+extern const char *frame_policy_name;
+
 /* Initialize the frame table */
 void frame_init(void);
 
-/* Allocate a frame */
+/* Allocate a frame, busy until frame_done() */
 void *frame_alloc(enum palloc_flags flags, void *upage);
 
+/* Allocate a frame to read UPAGE ahead into, if one is spare */
+void *frame_alloc_readahead(void *upage, enum frame_readahead kind);
+
+/* Share the cached frame for a read-only file page, if any */
+void *frame_share(struct file *file, off_t ofs, uint32_t read_bytes,
+                  void *upage);
+
+/* Add a frame just read from a file to the page cache */
+void frame_cache(void *kpage, struct file *file, off_t ofs,
+                 uint32_t read_bytes);
+
+/* Whether frames are spare, so loading ahead evicts nothing */
+bool frame_spare(void);
+
+/* Mark a frame as done with, to be evicted first */
+void frame_consumed(void *kpage);
+
+/* Make a filled and mapped frame evictable */
+void frame_done(void *kpage);
+
+/* Wait for an eviction from frame KPAGE to finish */
+void frame_wait(void *kpage);
+
+/* Share a frame with a child process, for fork() */
+bool frame_fork(void *kpage, struct thread *t, void *upage);
+
+/* Whether a frame is mapped by more than one process */
+bool frame_shared(void *kpage);
+
 /* Free a frame */
 void frame_free(void *kpage);
 
-/* Pin a frame (prevent eviction) */
-void frame_pin(void *kpage);
+/* Wait for evictions waiting on a page table's lock, to free it */
+void frame_release_spt(struct spt *spt);
+
+/* Map the shared zero page read-only for the current thread */
+bool frame_map_zero(void *upage);
+
+/* Pin the current thread's mapping of a frame (prevent eviction) */
+bool frame_pin(void *kpage);
 
-/* Unpin a frame (allow eviction) */
+/* Drop the current thread's pin on a frame (allow eviction) */
 void frame_unpin(void *kpage);
 
+/* Lock a frame in memory for mlock(), and undo it */
+bool frame_mlock(void *kpage);
+void frame_munlock(void *kpage);
+
+/* Print paging statistics */
+void frame_print_stats(void);
+
+/* Helpers for replacement policies */
+size_t frame_count(void);
+struct frame_entry *frame_at(size_t idx);
+bool frame_evictable(const struct frame_entry *);
+bool frame_test_and_clear_accessed(struct frame_entry *);
+
 #endif /* vm/frame.h */
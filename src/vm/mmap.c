@@ -84,11 +84,19 @@ mmap_unmap(int mapid)
       struct mmap_mapping *mapping = list_entry(e, struct mmap_mapping, elem);
       if (mapping->mapid == mapid)
         {
+          /* Pages locked by mlock() go with the mapping */
+          spt_munlock(&t->spt, mapping->start_addr, mapping->page_count);
+
           /* Write back dirty pages to file */
           for (size_t i = 0; i < mapping->page_count; i++)
             {
               void *upage = mapping->start_addr + i * PGSIZE;
               
+              /* Hold the SPT lock so the page cannot start being
+                 evicted, and let any eviction under way finish */
+              rwlock_acquire_write(&t->spt.lock);
+              struct spt_entry *entry = spt_wait_entry(&t->spt, upage);
+              
               /* Check if page is in page directory (loaded) */
               void *kpage = pagedir_get_page(t->pagedir, upage);
               if (kpage != NULL)
@@ -96,8 +104,6 @@ mmap_unmap(int mapid)
                   /* Check if page is dirty */
                   if (pagedir_is_dirty(t->pagedir, upage))
                     {
-                      /* Get SPT entry for file info */
-                      struct spt_entry *entry = spt_get_entry(&t->spt, upage);
                       if (entry != NULL && entry->type == PAGE_MMAP)
                         {
                           /* Write page back to file - only write the bytes that came from file */
@@ -111,10 +117,11 @@ mmap_unmap(int mapid)
                         }
                     }
                   
-                  /* Free the frame and clear page table entry */
-                  frame_free(kpage);
+                  /* Clear page table entry and free the frame */
                   pagedir_clear_page(t->pagedir, upage);
+                  frame_free(kpage);
                 }
+              rwlock_release_write(&t->spt.lock);
               
               /* Remove from SPT */
               spt_remove_entry(&t->spt, upage);
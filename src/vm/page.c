@@ -14,22 +14,89 @@
 static unsigned spt_hash_func(const struct hash_elem *e, void *aux);
 static bool spt_less_func(const struct hash_elem *a, const struct hash_elem *b, void *aux);
 static void spt_destroy_func(struct hash_elem *e, void *aux);
+static void load_swap(struct spt *spt, void *upage, size_t slot, void *kpage,
+                      size_t max);
+static void mark_consumed(struct spt *spt, void *upage);
+static bool drop_page(struct spt_entry *entry);
+static size_t collect_around(struct spt *spt, struct spt_entry *first,
+                             size_t window, struct spt_entry *ra[],
+                             void *kpages[]);
+static void map_around(struct spt *spt, struct spt_entry *ra[],
+                       void *kpages[], size_t cnt, bool shareable);
+static void wait_transits(struct spt *spt);
+static bool fork_entry(struct spt_entry *pe, struct thread *parent,
+                       struct file *(*map_file) (struct file *, void *aux),
+                       void *aux);
+
+/* Most pages read from swap on one fault, counting the faulting
+   page itself */
+#define SWAP_READAHEAD 8
+
+/* Most file pages read on one fault, counting the faulting page
+   itself.  The window starts at one page and doubles on each fault
+   that follows on from the last window, up to this many. */
+#define FAULT_AROUND_MAX 16
+
+/* Tries spt_mlock() makes at locking a page.  Locking a page not in
+   memory takes three: one to load it, one to copy it if it is still
+   shared since fork(), and one to lock it.  More are needed only if
+   the page is evicted again between loading and locking, which only
+   happens this often when memory is thrashing, and then failing
+   mlock() is better than spinning. */
+#define MLOCK_TRIES 8
+
+size_t spt_mlock_limit = 64;
 
 /* Initialize supplemental page table */
 void 
 spt_init(struct spt *spt)
 {
   hash_init(&spt->table, spt_hash_func, spt_less_func, NULL);
-  lock_init(&spt->lock);
+  rwlock_init_named(&spt->lock, "spt");
+  spt->fault_next = NULL;
+  spt->fault_window = 1;
+  spt->locked_cnt = 0;
+  spt->evict_waiters = 0;
 }
 
 /* Destroy supplemental page table and free all resources */
 void 
 spt_destroy(struct spt *spt)
 {
-  lock_acquire(&spt->lock);
+  /* Let evictions of our pages finish.  Once they have, holding
+     the lock keeps new ones from starting. */
+  rwlock_acquire_write(&spt->lock);
+  wait_transits(spt);
   hash_destroy(&spt->table, spt_destroy_func);
-  lock_release(&spt->lock);
+  rwlock_release_write(&spt->lock);
+  frame_release_spt(spt);
+}
+
+/* Waits until no page in SPT is being evicted.  SPT's write lock
+   must be held; it is released while waiting. */
+static void
+wait_transits(struct spt *spt)
+{
+  struct hash_iterator i;
+  bool waited;
+
+  do
+    {
+      waited = false;
+      hash_first(&i, &spt->table);
+      while (hash_next(&i))
+        {
+          struct spt_entry *entry = hash_entry(hash_cur(&i),
+                                               struct spt_entry, elem);
+          if (entry->in_transit)
+            {
+              spt_wait_entry(spt, entry->upage);
+              waited = true;
+              break;
+            }
+        }
+    }
+  while (waited);
 }
 
 static void check_write_back(struct spt_entry *entry)
@@ -63,16 +130,21 @@ spt_set_file(struct spt *spt, void *upage, struct file *file,
   entry->type = PAGE_FILE;
   entry->writable = writable;
   entry->loaded = false;
+  entry->in_transit = false;
+  entry->zero_mapped = false;
+  entry->cow = false;
+  entry->advice = ADVICE_NORMAL;
+  entry->locked = false;
   entry->file = file;
   entry->file_offset = ofs;
   entry->read_bytes = read_bytes;
   entry->zero_bytes = zero_bytes;
-  entry->swap_slot = 0;
+  entry->swap_slot = SWAP_SLOT_NONE;
   entry->mapid = -1;
   
-  lock_acquire(&spt->lock);
+  rwlock_acquire_write(&spt->lock);
   struct hash_elem *result = hash_insert(&spt->table, &entry->elem);
-  lock_release(&spt->lock);
+  rwlock_release_write(&spt->lock);
   
   if (result != NULL)
     {
@@ -96,16 +168,21 @@ spt_set_zero(struct spt *spt, void *upage, bool writable)
   entry->type = PAGE_ZERO;
   entry->writable = writable;
   entry->loaded = false;
+  entry->in_transit = false;
+  entry->zero_mapped = false;
+  entry->cow = false;
+  entry->advice = ADVICE_NORMAL;
+  entry->locked = false;
   entry->file = NULL;
   entry->file_offset = 0;
   entry->read_bytes = 0;
   entry->zero_bytes = PGSIZE;
-  entry->swap_slot = 0;
+  entry->swap_slot = SWAP_SLOT_NONE;
   entry->mapid = -1;
   
-  lock_acquire(&spt->lock);
+  rwlock_acquire_write(&spt->lock);
   struct hash_elem *result = hash_insert(&spt->table, &entry->elem);
-  lock_release(&spt->lock);
+  rwlock_release_write(&spt->lock);
   
   if (result != NULL)
     {
@@ -131,16 +208,21 @@ spt_set_mmap(struct spt *spt, void *upage, struct file *file,
   entry->type = PAGE_MMAP;
   entry->writable = true;  /* MMAP pages are always writable */
   entry->loaded = false;
+  entry->in_transit = false;
+  entry->zero_mapped = false;
+  entry->cow = false;
+  entry->advice = ADVICE_NORMAL;
+  entry->locked = false;
   entry->file = file;
   entry->file_offset = ofs;
   entry->read_bytes = read_bytes;
   entry->zero_bytes = zero_bytes;
-  entry->swap_slot = 0;
+  entry->swap_slot = SWAP_SLOT_NONE;
   entry->mapid = mapid;
   
-  lock_acquire(&spt->lock);
+  rwlock_acquire_write(&spt->lock);
   struct hash_elem *result = hash_insert(&spt->table, &entry->elem);
-  lock_release(&spt->lock);
+  rwlock_release_write(&spt->lock);
   
   if (result != NULL)
     {
@@ -155,17 +237,17 @@ spt_set_mmap(struct spt *spt, void *upage, struct file *file,
 bool 
 spt_set_loaded(struct spt *spt, void *upage, void *kpage)
 {
-  lock_acquire(&spt->lock);
+  rwlock_acquire_write(&spt->lock);
   struct spt_entry *entry = spt_get_entry(spt, upage);
   if (entry == NULL)
     {
-      lock_release(&spt->lock);
+      rwlock_release_write(&spt->lock);
       return false;
     }
   
   entry->kpage = kpage;
   entry->loaded = true;
-  lock_release(&spt->lock);
+  rwlock_release_write(&spt->lock);
   
   return true;
 }
@@ -186,18 +268,70 @@ spt_get_entry(struct spt *spt, void *upage)
   return hash_entry(e, struct spt_entry, elem);
 }
 
+/* Returns the entry for UPAGE in SPT, like spt_get_entry(), but
+   first waits for any eviction of the page that is under way to
+   finish writing it out.  The caller must hold SPT's write lock,
+   which is released while waiting. */
+struct spt_entry *
+spt_wait_entry(struct spt *spt, void *upage)
+{
+  struct spt_entry *entry;
+
+  ASSERT(rwlock_held_by_current_thread(&spt->lock));
+
+  entry = spt_get_entry(spt, upage);
+  while (entry != NULL && entry->in_transit)
+    {
+      void *kpage = entry->kpage;
+
+      rwlock_release_write(&spt->lock);
+      frame_wait(kpage);
+      rwlock_acquire_write(&spt->lock);
+      entry = spt_get_entry(spt, upage);
+    }
+  return entry;
+}
+
+/* Looks up UPAGE in SPT under the read lock.  Returns true if
+   it has an entry, storing whether the page is writable in
+   *WRITABLE if WRITABLE is non-null.  Lookups by different
+   threads of the same process do not serialize. */
+bool
+spt_query(struct spt *spt, void *upage, bool *writable)
+{
+  struct spt_entry *entry;
+
+  rwlock_acquire_read(&spt->lock);
+  entry = spt_get_entry(spt, upage);
+  if (entry != NULL && writable != NULL)
+    *writable = entry->writable;
+  rwlock_release_read(&spt->lock);
+
+  return entry != NULL;
+}
+
 /* Load a page into memory (called by page fault handler) */
 bool 
 spt_load_page(struct spt *spt, void *upage)
 {
-  lock_acquire(&spt->lock);
+  rwlock_acquire_write(&spt->lock);
   
-  struct spt_entry *entry = spt_get_entry(spt, upage);
+  /* If the page is being evicted, wait for it to reach swap or
+     its file rather than read a stale copy */
+  struct spt_entry *entry = spt_wait_entry(spt, upage);
   if (entry == NULL || entry->loaded)
     {
-      lock_release(&spt->lock);
+      rwlock_release_write(&spt->lock);
       return false;
     }
+
+  /* A write to a page mapped to the shared zero page gets the page
+     a frame of its own */
+  if (entry->zero_mapped)
+    {
+      pagedir_clear_page(thread_current()->pagedir, entry->upage);
+      entry->zero_mapped = false;
+    }
   
   /* Save entry information before releasing lock */
   enum page_type type = entry->type;
@@ -208,12 +342,42 @@ spt_load_page(struct spt *spt, void *upage)
   uint32_t read_bytes = entry->read_bytes;
   uint32_t zero_bytes = entry->zero_bytes;
   size_t swap_slot = entry->swap_slot;
+
+  enum page_advice advice = entry->advice;
+
+  /* A file fault just past the last one's window looks like
+     sequential access, so the window grows; any other resets it.
+     madvise() hints override the guess. */
+  size_t window = 1;
+  if ((type == PAGE_FILE || type == PAGE_MMAP) && advice != ADVICE_RANDOM)
+    {
+      if (advice == ADVICE_SEQUENTIAL)
+        spt->fault_window = FAULT_AROUND_MAX;
+      else if (upage_addr != spt->fault_next)
+        spt->fault_window = 1;
+      else if (spt->fault_window < FAULT_AROUND_MAX)
+        spt->fault_window *= 2;
+      window = spt->fault_window;
+      spt->fault_next = upage_addr + PGSIZE;
+    }
+  if (advice == ADVICE_SEQUENTIAL)
+    mark_consumed(spt, upage_addr);
   
   /* CRITICAL: Release lock before frame allocation to avoid deadlock */
-  lock_release(&spt->lock);
+  rwlock_release_write(&spt->lock);
   
-  /* Allocate a frame WITHOUT holding the SPT lock */
-  void *kpage = frame_alloc(PAL_USER, upage_addr);
+  /* A read-only file page, such as program text, may already be
+     in memory for another process running the same program */
+  bool shareable = type == PAGE_FILE && !writable;
+  void *kpage = NULL;
+  if (shareable)
+    kpage = frame_share(file, file_offset, read_bytes, upage_addr);
+  bool shared = kpage != NULL;
+
+  /* Allocate a frame WITHOUT holding the SPT lock.  It stays busy,
+     safe from eviction, until frame_done() */
+  if (!shared)
+    kpage = frame_alloc(PAL_USER, upage_addr);
   if (kpage == NULL)
     {
       return false;
@@ -222,9 +386,26 @@ spt_load_page(struct spt *spt, void *upage)
   /* Load page content based on type */
   bool success = false;
   
-  if (type == PAGE_FILE || type == PAGE_MMAP)
+  if (shared)
+    success = true;
+  else if (type == PAGE_FILE || type == PAGE_MMAP)
     {
-      /* Load from file */
+      /* Load from file, along with the pages that follow it in the
+         file and in memory, up to the fault-around window */
+      struct spt_entry *ra[FAULT_AROUND_MAX];
+      void *kpages[FAULT_AROUND_MAX];
+      size_t cnt = 1, i;
+
+      kpages[0] = kpage;
+      if (window > 1 && read_bytes == PGSIZE)
+        {
+          rwlock_acquire_read(&spt->lock);
+          entry = spt_get_entry(spt, upage);
+          if (entry != NULL)
+            cnt = collect_around(spt, entry, window, ra, kpages);
+          rwlock_release_read(&spt->lock);
+        }
+
       lock_acquire(&file_lock);
       if (read_bytes > 0)
         {
@@ -232,12 +413,27 @@ spt_load_page(struct spt *spt, void *upage)
           if (file_read(file, kpage, read_bytes) != (int) read_bytes)
             {
               lock_release(&file_lock);
-              frame_free(kpage);
+              for (i = 0; i < cnt; i++)
+                frame_free(kpages[i]);
               return false;
             }
         }
+      for (i = 1; i < cnt; i++)
+        if (file_read_at(file, kpages[i], ra[i]->read_bytes,
+                         ra[i]->file_offset) != (int) ra[i]->read_bytes)
+          break;
       lock_release(&file_lock);
+
+      /* Leave a page that could not be read, and those after it,
+         to fault in on their own */
+      for (; cnt > i; cnt--)
+        frame_free(kpages[cnt - 1]);
+      spt->fault_next = upage_addr + cnt * PGSIZE;
+
       memset(kpage + read_bytes, 0, zero_bytes);
+      if (shareable)
+        frame_cache(kpage, file, file_offset, read_bytes);
+      map_around(spt, ra, kpages, cnt, shareable);
       success = true;
     }
   else if (type == PAGE_ZERO)
@@ -248,8 +444,9 @@ spt_load_page(struct spt *spt, void *upage)
     }
   else if (type == PAGE_SWAP)
     {
-      /* Load from swap */
-      swap_in(swap_slot, kpage);
+      /* Load from swap, with readahead */
+      load_swap(spt, upage_addr, swap_slot, kpage,
+                advice == ADVICE_RANDOM ? 1 : SWAP_READAHEAD);
       success = true;
     }
   
@@ -258,19 +455,23 @@ spt_load_page(struct spt *spt, void *upage)
       /* Install page into page table */
       if (!pagedir_set_page(thread_current()->pagedir, upage_addr, kpage, writable))
         {
+          /* A shared frame stays busy until we are off it */
           frame_free(kpage);
+          if (shared)
+            frame_done(kpage);
           return false;
         }
       
       /* Re-acquire lock to update entry */
-      lock_acquire(&spt->lock);
+      rwlock_acquire_write(&spt->lock);
       entry = spt_get_entry(spt, upage);
       if (entry != NULL)
         {
           entry->kpage = kpage;
           entry->loaded = true;
         }
-      lock_release(&spt->lock);
+      rwlock_release_write(&spt->lock);
+      frame_done(kpage);
     }
   else
     {
@@ -280,16 +481,543 @@ spt_load_page(struct spt *spt, void *upage)
   return success;
 }
 
+/* Maps UPAGE, if it is a zero page not yet in memory, read-only to
+   the shared zero page, so that a process that only reads it needs
+   no frame.  A later write faults and goes to spt_load_page(). */
+bool
+spt_map_zero(struct spt *spt, void *upage)
+{
+  struct spt_entry *entry;
+  bool success = false;
+
+  rwlock_acquire_write(&spt->lock);
+  entry = spt_wait_entry(spt, upage);
+  if (entry != NULL && entry->type == PAGE_ZERO && !entry->loaded
+      && !entry->zero_mapped && frame_map_zero(entry->upage))
+    {
+      entry->zero_mapped = true;
+      success = true;
+    }
+  rwlock_release_write(&spt->lock);
+  return success;
+}
+
+/* Handles a write to UPAGE, a copy-on-write page shared since
+   fork().  If no other process maps its frame any more, the page
+   is just made writable; otherwise it is copied to a new frame.
+   Either way the page is marked dirty: it is private from now on,
+   and mlock() breaks sharing without writing, so a clean page
+   could otherwise be dropped on eviction instead of saved.
+   Returns false if UPAGE is not a copy-on-write page. */
+bool
+spt_break_cow(struct spt *spt, void *upage)
+{
+  uint32_t *pd = thread_current()->pagedir;
+  struct spt_entry *entry;
+  void *kpage;
+
+  rwlock_acquire_write(&spt->lock);
+  entry = spt_wait_entry(spt, upage);
+  if (entry == NULL || !entry->cow || !entry->loaded)
+    {
+      rwlock_release_write(&spt->lock);
+      return false;
+    }
+  upage = entry->upage;
+  if (!frame_shared(entry->kpage))
+    {
+      pagedir_clear_page(pd, upage);
+      pagedir_set_page(pd, upage, entry->kpage, true);
+      pagedir_set_dirty(pd, upage, true);
+      entry->cow = false;
+      rwlock_release_write(&spt->lock);
+      return true;
+    }
+  rwlock_release_write(&spt->lock);
+
+  /* As in spt_load_page(), no lock may be held to allocate */
+  kpage = frame_alloc(PAL_USER, upage);
+  rwlock_acquire_write(&spt->lock);
+  entry = spt_wait_entry(spt, upage);
+  if (entry == NULL || !entry->cow || !entry->loaded)
+    {
+      /* Evicted meanwhile: the write will fault it back in */
+      rwlock_release_write(&spt->lock);
+      frame_free(kpage);
+      return true;
+    }
+
+  /* Holding the lock keeps the shared frame from eviction.  A lock
+     from mlock() moves to the copy. */
+  memcpy(kpage, entry->kpage, PGSIZE);
+  pagedir_clear_page(pd, upage);
+  if (entry->locked)
+    {
+      frame_munlock(entry->kpage);
+      if (!frame_mlock(kpage))
+        {
+          entry->locked = false;
+          spt->locked_cnt--;
+        }
+    }
+  frame_free(entry->kpage);
+  pagedir_set_page(pd, upage, kpage, true);
+  pagedir_set_dirty(pd, upage, true);
+  entry->kpage = kpage;
+  entry->cow = false;
+  rwlock_release_write(&spt->lock);
+  frame_done(kpage);
+  return true;
+}
+
+/* Copies every page of PARENT into the current thread's page
+   table, for fork().  Pages in memory are shared copy-on-write,
+   and pages in swap share their slots.  MAP_FILE translates each
+   of PARENT's files to the child's copy of it, given AUX.  Returns
+   false if memory runs out, leaving a partial copy for
+   spt_destroy() to clean up. */
+bool
+spt_fork(struct thread *parent,
+         struct file *(*map_file) (struct file *, void *aux), void *aux)
+{
+  struct spt *child = &thread_current()->spt;
+  struct hash_iterator i;
+  bool success = true;
+
+  /* Keep the parent's pages from being evicted while they are
+     copied.  The child's lock keeps the pages it gets from being
+     evicted before its entries are filled in. */
+  rwlock_acquire_write(&parent->spt.lock);
+  wait_transits(&parent->spt);
+  rwlock_acquire_write(&child->lock);
+  hash_first(&i, &parent->spt.table);
+  while (success && hash_next(&i))
+    success = fork_entry(hash_entry(hash_cur(&i), struct spt_entry, elem),
+                         parent, map_file, aux);
+  rwlock_release_write(&child->lock);
+  rwlock_release_write(&parent->spt.lock);
+  return success;
+}
+
+/* Adds a copy of PE, an entry of PARENT's, to the current
+   thread's page table.  Both locks must be held. */
+static bool
+fork_entry(struct spt_entry *pe, struct thread *parent,
+           struct file *(*map_file) (struct file *, void *aux), void *aux)
+{
+  struct thread *t = thread_current();
+  uint32_t *ppd = parent->pagedir;
+  struct spt_entry *ce = malloc(sizeof *ce);
+
+  if (ce == NULL)
+    return false;
+  *ce = *pe;
+  ce->kpage = NULL;
+  ce->loaded = false;
+  ce->zero_mapped = false;
+  ce->cow = false;
+  ce->locked = false;
+  ce->swap_slot = SWAP_SLOT_NONE;
+  ce->file = pe->file != NULL ? map_file(pe->file, aux) : NULL;
+  if (pe->file != NULL && ce->file == NULL)
+    {
+      free(ce);
+      return false;
+    }
+  hash_insert(&t->spt.table, &ce->elem);
+
+  /* A resident page written since it was swapped in no longer
+     matches its slot.  Drop the slot now, since the write-protected
+     mappings below cannot show the page dirty later. */
+  if (pe->loaded && pe->swap_slot != SWAP_SLOT_NONE
+      && pagedir_is_dirty(ppd, pe->upage))
+    {
+      swap_free(pe->swap_slot);
+      pe->swap_slot = SWAP_SLOT_NONE;
+    }
+  if (pe->swap_slot != SWAP_SLOT_NONE)
+    {
+      swap_dup(pe->swap_slot);
+      ce->swap_slot = pe->swap_slot;
+    }
+
+  if (pe->type == PAGE_MMAP)
+    {
+      /* The child reads the file afresh, so it must be current */
+      if (pe->loaded && pagedir_is_dirty(ppd, pe->upage))
+        {
+          lock_acquire(&file_lock);
+          file_write_at(pe->file, pe->kpage, pe->read_bytes,
+                        pe->file_offset);
+          lock_release(&file_lock);
+          pagedir_set_dirty(ppd, pe->upage, false);
+        }
+    }
+  else if (pe->zero_mapped)
+    ce->zero_mapped = frame_map_zero(ce->upage);
+  else if (pe->loaded)
+    {
+      if (!frame_fork(pe->kpage, t, ce->upage))
+        return false;
+      if (!pagedir_set_page(t->pagedir, ce->upage, pe->kpage, false))
+        {
+          frame_free(pe->kpage);
+          return false;
+        }
+      ce->kpage = pe->kpage;
+      ce->loaded = true;
+      if (pe->writable)
+        {
+          if (!pe->cow)
+            {
+              pagedir_clear_page(ppd, pe->upage);
+              pagedir_set_page(ppd, pe->upage, pe->kpage, false);
+            }
+          pe->cow = ce->cow = true;
+        }
+    }
+  return true;
+}
+
+/* Reads UPAGE from swap SLOT into KPAGE.  Up to MAX - 1 of the
+   pages that follow UPAGE are read in the same operation while
+   their slots follow SLOT, as they do when the page-out daemon
+   swaps out a run of them together, and there are frames to
+   spare.  They are mapped right away, so touching them costs no
+   fault.
+
+   Each page keeps its slot, which still holds a copy of it, so
+   that it can be evicted again without a write as long as it stays
+   clean.  evict_begin() gives up the slot of a page found dirty,
+   and swap_out_cluster() takes slots back from resident pages when
+   swap runs out. */
+static void
+load_swap(struct spt *spt, void *upage, size_t slot, void *kpage,
+          size_t max)
+{
+  struct thread *t = thread_current();
+  struct spt_entry *ra[SWAP_READAHEAD];
+  void *kpages[SWAP_READAHEAD];
+  size_t cnt, i;
+
+  /* Only this thread changes the swap slots of its pages that are
+     not resident, and the frames from frame_alloc_readahead() are busy, so the entries
+     stay as found once the lock is dropped */
+  kpages[0] = kpage;
+  rwlock_acquire_read(&spt->lock);
+  for (cnt = 1; cnt < max; cnt++)
+    {
+      void *next = (uint8_t *) upage + cnt * PGSIZE;
+      struct spt_entry *e = spt_get_entry(spt, next);
+
+      if (e == NULL || e->type != PAGE_SWAP || e->loaded || e->in_transit
+          || e->swap_slot != slot + cnt)
+        break;
+      kpages[cnt] = frame_alloc_readahead(next, READAHEAD_SWAP);
+      if (kpages[cnt] == NULL)
+        break;
+      ra[cnt] = e;
+    }
+  rwlock_release_read(&spt->lock);
+
+  swap_read_cluster(slot, kpages, cnt);
+
+  for (i = 1; i < cnt; i++)
+    {
+      struct spt_entry *e = ra[i];
+
+      if (!pagedir_set_page(t->pagedir, e->upage, kpages[i], e->writable))
+        {
+          /* Leave the page in swap */
+          frame_free(kpages[i]);
+          continue;
+        }
+      rwlock_acquire_write(&spt->lock);
+      e->kpage = kpages[i];
+      e->loaded = true;
+      rwlock_release_write(&spt->lock);
+      frame_done(kpages[i]);
+    }
+}
+
+/* Fault-around.  Collects into RA the pages after FIRST, up to
+   WINDOW pages in all, that continue FIRST's part of its file:
+   pages of the same kind, mapping the next bytes of the same file,
+   and not yet in memory.  Stops at the first page that does not
+   qualify or for which no frame is spare, and allocates a frame
+   for each page in KPAGES.  Returns the number of pages, counting
+   FIRST.  SPT's lock must be held.
+
+   As in load_swap(), the entries stay as found once the lock is
+   dropped, since only this thread loads its pages. */
+static size_t
+collect_around(struct spt *spt, struct spt_entry *first, size_t window,
+               struct spt_entry *ra[], void *kpages[])
+{
+  struct spt_entry *prev = first;
+  size_t cnt;
+
+  for (cnt = 1; cnt < window; cnt++)
+    {
+      void *next = (uint8_t *) first->upage + cnt * PGSIZE;
+      struct spt_entry *e = spt_get_entry(spt, next);
+
+      if (e == NULL || e->type != first->type || e->file != first->file
+          || e->writable != first->writable
+          || e->file_offset != prev->file_offset + PGSIZE
+          || prev->read_bytes != PGSIZE || e->read_bytes == 0
+          || e->loaded || e->in_transit || e->zero_mapped
+          || e->swap_slot != SWAP_SLOT_NONE)
+        break;
+      kpages[cnt] = frame_alloc_readahead(next, READAHEAD_FILE);
+      if (kpages[cnt] == NULL)
+        break;
+      ra[cnt] = prev = e;
+    }
+  return cnt;
+}
+
+/* Zero-fills the tails of the CNT - 1 pages read around a fault
+   into KPAGES[1] onward and maps them.  Like the faulting page,
+   they go into the page cache if SHAREABLE. */
+static void
+map_around(struct spt *spt, struct spt_entry *ra[], void *kpages[],
+           size_t cnt, bool shareable)
+{
+  struct thread *t = thread_current();
+  size_t i;
+
+  for (i = 1; i < cnt; i++)
+    {
+      struct spt_entry *e = ra[i];
+
+      memset(kpages[i] + e->read_bytes, 0, e->zero_bytes);
+      if (shareable)
+        frame_cache(kpages[i], e->file, e->file_offset, e->read_bytes);
+      if (!pagedir_set_page(t->pagedir, e->upage, kpages[i], e->writable))
+        {
+          frame_free(kpages[i]);
+          continue;
+        }
+      rwlock_acquire_write(&spt->lock);
+      e->kpage = kpages[i];
+      e->loaded = true;
+      rwlock_release_write(&spt->lock);
+      frame_done(kpages[i]);
+    }
+}
+
+/* For a fault at UPAGE in a range read sequentially, marks the
+   pages the reader has left behind, FAULT_AROUND_MAX to
+   2 * FAULT_AROUND_MAX - 1 pages back, as consumed, so that they
+   are evicted first.  Since no fault moves the reader on by more
+   than FAULT_AROUND_MAX pages, every page it passes is marked.
+   SPT's lock must be held. */
+static void
+mark_consumed(struct spt *spt, void *upage)
+{
+  size_t i;
+
+  for (i = FAULT_AROUND_MAX; i < 2 * FAULT_AROUND_MAX; i++)
+    {
+      struct spt_entry *e;
+
+      if ((uintptr_t) upage < i * PGSIZE)
+        break;
+      e = spt_get_entry(spt, (uint8_t *) upage - i * PGSIZE);
+      if (e != NULL && e->advice == ADVICE_SEQUENTIAL && e->loaded
+          && !e->in_transit)
+        frame_consumed(e->kpage);
+    }
+}
+
+/* Drops the page of ENTRY, for madvise() with ADVICE_DONTNEED.  A
+   dirty mmap page is written back first.  Any other page loses its
+   contents, even in swap, and reads back from its file or as zeros,
+   as it did before it was first written.  Returns false, dropping
+   nothing, if the page is locked in memory.  SPT's lock must be
+   held, and the page must not be in transit. */
+static bool
+drop_page(struct spt_entry *entry)
+{
+  uint32_t *pd = thread_current()->pagedir;
+
+  if (entry->locked)
+    return false;
+
+  if (entry->zero_mapped)
+    {
+      pagedir_clear_page(pd, entry->upage);
+      entry->zero_mapped = false;
+    }
+  if (entry->loaded)
+    {
+      if (entry->type == PAGE_MMAP && pagedir_is_dirty(pd, entry->upage))
+        {
+          lock_acquire(&file_lock);
+          file_write_at(entry->file, entry->kpage, entry->read_bytes,
+                        entry->file_offset);
+          lock_release(&file_lock);
+        }
+      pagedir_clear_page(pd, entry->upage);
+      frame_free(entry->kpage);
+      entry->kpage = NULL;
+      entry->loaded = false;
+      entry->cow = false;
+    }
+  if (entry->type != PAGE_MMAP)
+    {
+      if (entry->swap_slot != SWAP_SLOT_NONE)
+        {
+          swap_free(entry->swap_slot);
+          entry->swap_slot = SWAP_SLOT_NONE;
+        }
+      entry->type = entry->file != NULL ? PAGE_FILE : PAGE_ZERO;
+    }
+  return true;
+}
+
+/* Applies ADVICE to the PAGE_CNT pages starting at UPAGE.
+   ADVICE_WILLNEED loads the pages not in memory, but only while
+   frames are spare, so that it never evicts anything.  Returns
+   false if any of the pages is not one of the process's, after
+   applying ADVICE to the others.  ADVICE_DONTNEED also fails on
+   pages locked by mlock(), which it leaves alone. */
+bool
+spt_advise(struct spt *spt, void *upage, size_t page_cnt,
+           enum page_advice advice)
+{
+  struct spt_entry *e;
+  bool success = true;
+  size_t i;
+
+  rwlock_acquire_write(&spt->lock);
+  for (i = 0; i < page_cnt; i++)
+    {
+      e = spt_wait_entry(spt, (uint8_t *) upage + i * PGSIZE);
+      if (e == NULL)
+        success = false;
+      else if (advice == ADVICE_DONTNEED)
+        success = drop_page(e) && success;
+      else if (advice != ADVICE_WILLNEED)
+        e->advice = advice;
+    }
+  rwlock_release_write(&spt->lock);
+
+  /* A zero page needs no reading, so it is left to fault in */
+  if (advice == ADVICE_WILLNEED)
+    for (i = 0; i < page_cnt && frame_spare(); i++)
+      {
+        void *page = (uint8_t *) upage + i * PGSIZE;
+        bool load;
+
+        rwlock_acquire_read(&spt->lock);
+        e = spt_get_entry(spt, page);
+        load = e != NULL && !e->loaded && e->type != PAGE_ZERO;
+        rwlock_release_read(&spt->lock);
+        if (load)
+          spt_load_page(spt, page);
+      }
+  return success;
+}
+
+/* Locks the PAGE_CNT pages starting at UPAGE in memory for
+   mlock(), loading them first.  A copy-on-write page is copied, and
+   a page mapped to the shared zero page gets a frame, so that
+   writing it later needs no fault either.  Fails, locking nothing,
+   if any of the pages is not one of the process's or the process
+   would go over spt_mlock_limit.  Otherwise returns false if memory
+   runs short, leaving the pages locked so far locked. */
+bool
+spt_mlock(struct spt *spt, void *upage, size_t page_cnt)
+{
+  struct spt_entry *e;
+  size_t i, new_cnt = 0;
+
+  rwlock_acquire_read(&spt->lock);
+  for (i = 0; i < page_cnt; i++)
+    {
+      e = spt_get_entry(spt, (uint8_t *) upage + i * PGSIZE);
+      if (e == NULL)
+        break;
+      if (!e->locked)
+        new_cnt++;
+    }
+  rwlock_release_read(&spt->lock);
+  if (i < page_cnt || spt->locked_cnt + new_cnt > spt_mlock_limit)
+    return false;
+
+  for (i = 0; i < page_cnt; i++)
+    {
+      void *page = (uint8_t *) upage + i * PGSIZE;
+      bool done = false;
+      int tries;
+
+      for (tries = 0; !done && tries < MLOCK_TRIES; tries++)
+        {
+          rwlock_acquire_write(&spt->lock);
+          e = spt_wait_entry(spt, page);
+          if (e == NULL)
+            {
+              rwlock_release_write(&spt->lock);
+              return false;
+            }
+          done = e->locked;
+          if (!done && e->loaded && !e->cow)
+            {
+              if (!frame_mlock(e->kpage))
+                {
+                  rwlock_release_write(&spt->lock);
+                  return false;
+                }
+              e->locked = done = true;
+              spt->locked_cnt++;
+            }
+          rwlock_release_write(&spt->lock);
+
+          /* Load it, or give it a frame of its own, and try again */
+          if (!done && !spt_break_cow(spt, page))
+            spt_load_page(spt, page);
+        }
+      if (!done)
+        return false;
+    }
+  return true;
+}
+
+/* Undoes spt_mlock() for the PAGE_CNT pages starting at UPAGE.
+   Pages that are not locked are skipped. */
+void
+spt_munlock(struct spt *spt, void *upage, size_t page_cnt)
+{
+  size_t i;
+
+  rwlock_acquire_write(&spt->lock);
+  for (i = 0; i < page_cnt; i++)
+    {
+      struct spt_entry *e = spt_get_entry(spt, (uint8_t *) upage + i * PGSIZE);
+
+      if (e != NULL && e->locked)
+        {
+          ASSERT(e->loaded);
+          frame_munlock(e->kpage);
+          e->locked = false;
+          spt->locked_cnt--;
+        }
+    }
+  rwlock_release_write(&spt->lock);
+}
+
 /* Set page to swap */
 bool 
 spt_set_swap(struct spt *spt, void *upage, size_t swap_slot)
 {
-  lock_acquire(&spt->lock);
+  rwlock_acquire_write(&spt->lock);
   
   struct spt_entry *entry = spt_get_entry(spt, upage);
   if (entry == NULL)
     {
-      lock_release(&spt->lock);
+      rwlock_release_write(&spt->lock);
       return false;
     }
   
@@ -298,7 +1026,7 @@ spt_set_swap(struct spt *spt, void *upage, size_t swap_slot)
   entry->loaded = false;
   entry->kpage = NULL;
   
-  lock_release(&spt->lock);
+  rwlock_release_write(&spt->lock);
   return true;
 }
 
@@ -306,24 +1034,23 @@ spt_set_swap(struct spt *spt, void *upage, size_t swap_slot)
 void 
 spt_remove_entry(struct spt *spt, void *upage)
 {
-  lock_acquire(&spt->lock);
-  
-  struct spt_entry dummy;
-  dummy.upage = pg_round_down(upage);
+  rwlock_acquire_write(&spt->lock);
   
-  struct hash_elem *e = hash_delete(&spt->table, &dummy.elem);
-  if (e != NULL)
+  struct spt_entry *entry = spt_wait_entry(spt, upage);
+  if (entry != NULL)
     {
-      struct spt_entry *entry = hash_entry(e, struct spt_entry, elem);
+      hash_delete(&spt->table, &entry->elem);
+      if (entry->zero_mapped)
+        pagedir_clear_page(thread_current()->pagedir, entry->upage);
       
       /* Free swap slot if page is in swap */
-      if (entry->type == PAGE_SWAP && entry->swap_slot != 0)
+      if (entry->swap_slot != SWAP_SLOT_NONE)
         swap_free(entry->swap_slot);
       
       free(entry);
     }
   
-  lock_release(&spt->lock);
+  rwlock_release_write(&spt->lock);
 }
 
 /* Hash function for supplemental page table */
@@ -352,10 +1079,16 @@ spt_destroy_func(struct hash_elem *e, void *aux UNUSED)
   
   check_write_back(entry);
 
-  /* Only free the frame if the page is still in the page directory */
+  /* Only free the frame if the page is still in the page directory,
+     and is not the shared zero page */
   void *kpage = pagedir_get_page(t->pagedir, entry->upage);
-  if (kpage != NULL)
+  if (entry->zero_mapped)
+    pagedir_clear_page(t->pagedir, entry->upage);
+  else if (kpage != NULL)
     {
+      if (entry->locked)
+        frame_munlock(kpage);
+
       /* Clear from page directory first */
       pagedir_clear_page(t->pagedir, entry->upage);
       /* Then free the frame */
@@ -363,7 +1096,7 @@ spt_destroy_func(struct hash_elem *e, void *aux UNUSED)
     }
   
   /* Free swap slot if in swap */
-  if (entry->type == PAGE_SWAP && entry->swap_slot != 0)
+  if (entry->swap_slot != SWAP_SLOT_NONE)
     swap_free(entry->swap_slot);
   
   free(entry);
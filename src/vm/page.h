@@ -5,6 +5,8 @@
 #include "filesys/off_t.h"
 #include "threads/synch.h"
 
+struct thread;
+
 /* Page types */
 enum page_type 
 {
@@ -14,6 +16,19 @@ enum page_type
   PAGE_MMAP       /* Memory-mapped file page */
 };
 
+/* Access pattern hints, given by madvise().  The values match the
+   MADV_* constants of <syscall.h>.  Only the first three are kept
+   in a page's entry; the others ask for action right away. */
+enum page_advice
+{
+  ADVICE_NORMAL,      /* No hint */
+  ADVICE_RANDOM,      /* Touched in no order: read nothing ahead */
+  ADVICE_SEQUENTIAL,  /* Touched once, in order: read far ahead and
+                         evict pages soon after they are passed */
+  ADVICE_WILLNEED,    /* Needed soon: load now */
+  ADVICE_DONTNEED     /* Not needed: drop, discarding private data */
+};
+
 /* Supplemental page table entry */
 struct spt_entry 
 {
@@ -22,6 +37,11 @@ struct spt_entry
   enum page_type type;      /* Type of page */
   bool writable;            /* Whether page is writable */
   bool loaded;              /* Whether page is currently in memory */
+  bool in_transit;          /* Being evicted from frame KPAGE */
+  bool zero_mapped;         /* Mapped to the shared zero page */
+  bool cow;                 /* Mapped read-only, copied on write */
+  enum page_advice advice;  /* Hint from madvise() */
+  bool locked;              /* Held in memory by mlock() */
   
   /* For file-backed pages (both PAGE_FILE and PAGE_MMAP) */
   struct file *file;        /* File to read from */
@@ -42,9 +62,20 @@ struct spt_entry
 struct spt 
 {
   struct hash table;        /* Hash table of page entries */
-  struct lock lock;         /* Lock for synchronization */
+  struct rwlock lock;       /* Readers-writer lock for synchronization */
+
+  /* Fault-around state, touched only by the owner's page faults */
+  void *fault_next;         /* Page just past the last file fault's window */
+  unsigned fault_window;    /* Pages to read on the next file fault */
+
+  size_t locked_cnt;        /* Pages held in memory by mlock() */
+  unsigned evict_waiters;   /* Evictions waiting on LOCK, under frame lock */
 };
 
+/* Most pages one process may lock in memory with mlock().
+   Controlled by kernel command-line option "-mlock=PAGES". */
+extern size_t spt_mlock_limit;
+
 /* Initialize supplemental page table */
 void spt_init(struct spt *spt);
 
@@ -70,9 +101,34 @@ bool spt_set_loaded(struct spt *spt, void *upage, void *kpage);
 /* Get supplemental page table entry for a user page */
 struct spt_entry *spt_get_entry(struct spt *spt, void *upage);
 
+/* Get the entry once no eviction of the page is under way */
+struct spt_entry *spt_wait_entry(struct spt *spt, void *upage);
+
+/* Look up a page under the read lock */
+bool spt_query(struct spt *spt, void *upage, bool *writable);
+
 /* Load a page into memory (called by page fault handler) */
 bool spt_load_page(struct spt *spt, void *upage);
 
+/* Map a zero page to the shared zero page, for a read fault */
+bool spt_map_zero(struct spt *spt, void *upage);
+
+/* Give a copy-on-write page a frame of its own, for a write fault */
+bool spt_break_cow(struct spt *spt, void *upage);
+
+/* Copy PARENT's pages into the current thread's table, for fork() */
+bool spt_fork(struct thread *parent,
+              struct file *(*map_file) (struct file *, void *aux),
+              void *aux);
+
+/* Apply a madvise() hint to PAGE_CNT pages starting at UPAGE */
+bool spt_advise(struct spt *spt, void *upage, size_t page_cnt,
+                enum page_advice advice);
+
+/* Lock PAGE_CNT pages starting at UPAGE in memory, or unlock them */
+bool spt_mlock(struct spt *spt, void *upage, size_t page_cnt);
+void spt_munlock(struct spt *spt, void *upage, size_t page_cnt);
+
 /* Set page to swap */
 bool spt_set_swap(struct spt *spt, void *upage, size_t swap_slot);
 
@@ -0,0 +1,472 @@
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "vm/frame.h"
+
+/* Page replacement policies for the frame table.  Every hook is
+   called by frame.c with the frame table lock held, which protects
+   the state kept here, so the hooks take no locks of their own and
+   must not sleep.  Each victim() scan is bounded; if nothing
+   suitable turns up, the first evictable frame is taken instead. */
+
+static struct frame_entry *any_evictable(void);
+
+/* Returns the first evictable frame, or NULL if all are pinned */
+static struct frame_entry *
+any_evictable(void)
+{
+  size_t i;
+
+  for (i = 0; i < frame_count(); i++)
+    if (frame_evictable(frame_at(i)))
+      return frame_at(i);
+  return NULL;
+}
+
+/* ---------------------------------------------------------------- */
+/* Clock: one hand sweeps the frame table, giving every recently
+   accessed page a second chance. */
+
+static size_t clock_hand;
+
+static void
+clock_init(size_t frame_cnt UNUSED)
+{
+  clock_hand = 0;
+}
+
+static void
+clock_insert(struct frame_entry *e UNUSED)
+{
+}
+
+static void
+clock_remove(struct frame_entry *e UNUSED)
+{
+}
+
+/* The hand has already moved past a passed-over victim */
+static void
+clock_requeue(struct frame_entry *e UNUSED)
+{
+}
+
+static struct frame_entry *
+clock_victim(void)
+{
+  size_t cnt = frame_count();
+  size_t i;
+
+  for (i = 0; i < 2 * cnt; i++)
+    {
+      struct frame_entry *e = frame_at(clock_hand);
+
+      clock_hand = (clock_hand + 1) % cnt;
+      if (frame_evictable(e) && !frame_test_and_clear_accessed(e))
+        return e;
+    }
+  return any_evictable();
+}
+
+const struct frame_policy frame_policy_clock =
+  {"clock", clock_init, clock_insert, clock_remove, clock_victim,
+   clock_requeue};
+
+/* ---------------------------------------------------------------- */
+/* Two-handed clock: the front hand clears accessed bits and the
+   back hand, a fixed spread behind it, evicts pages that have not
+   been touched since the front hand passed.  Unlike plain clock,
+   the time a page has to prove itself does not grow with memory
+   size. */
+
+static size_t clock2_hand;          /* Front hand */
+static size_t clock2_spread;        /* Distance from back to front hand */
+
+static void
+clock2_init(size_t frame_cnt)
+{
+  clock2_hand = 0;
+  clock2_spread = frame_cnt / 4 > 0 ? frame_cnt / 4 : 1;
+}
+
+static struct frame_entry *
+clock2_victim(void)
+{
+  size_t cnt = frame_count();
+  size_t i;
+
+  for (i = 0; i < 2 * cnt; i++)
+    {
+      struct frame_entry *front = frame_at(clock2_hand);
+      struct frame_entry *back = frame_at((clock2_hand + cnt - clock2_spread)
+                                          % cnt);
+
+      clock2_hand = (clock2_hand + 1) % cnt;
+      if (frame_evictable(front))
+        frame_test_and_clear_accessed(front);
+      if (frame_evictable(back) && !frame_test_and_clear_accessed(back))
+        return back;
+    }
+  return any_evictable();
+}
+
+const struct frame_policy frame_policy_clock2 =
+  {"clock2", clock2_init, clock_insert, clock_remove, clock2_victim,
+   clock_requeue};
+
+/* ---------------------------------------------------------------- */
+/* Helpers for the list-based policies below.  A frame's
+   policy_list says which of the policy's lists holds it. */
+
+#define LIST_NONE 0
+#define LIST_MAX 3
+
+static struct list policy_lists[LIST_MAX];
+static size_t policy_list_cnt[LIST_MAX];
+
+static void
+lists_init(void)
+{
+  int i;
+
+  for (i = 0; i < LIST_MAX; i++)
+    {
+      list_init(&policy_lists[i]);
+      policy_list_cnt[i] = 0;
+    }
+}
+
+/* Moves E to the tail of list WHICH */
+static void
+policy_move(struct frame_entry *e, int which)
+{
+  if (e->policy_list != LIST_NONE)
+    {
+      list_remove(&e->policy_elem);
+      policy_list_cnt[e->policy_list]--;
+    }
+  e->policy_list = which;
+  if (which != LIST_NONE)
+    {
+      list_push_back(&policy_lists[which], &e->policy_elem);
+      policy_list_cnt[which]++;
+    }
+}
+
+static void
+lists_remove(struct frame_entry *e)
+{
+  policy_move(e, LIST_NONE);
+}
+
+/* Moves E to the tail of the list it is on */
+static void
+lists_requeue(struct frame_entry *e)
+{
+  policy_move(e, e->policy_list);
+}
+
+/* Returns the oldest frame on list WHICH, or NULL if it is empty */
+static struct frame_entry *
+policy_oldest(int which)
+{
+  if (list_empty(&policy_lists[which]))
+    return NULL;
+  return list_entry(list_front(&policy_lists[which]),
+                    struct frame_entry, policy_elem);
+}
+
+/* ---------------------------------------------------------------- */
+/* Approximate LRU with active and inactive lists.  New pages start
+   inactive and are promoted when seen accessed twice, since the
+   first accessed bit usually comes from the fault that brought the
+   page in; the oldest active pages are demoted to keep at least a
+   third of all pages inactive.  Victims come from the head of the
+   inactive list. */
+
+#define LRU_ACTIVE 1
+#define LRU_INACTIVE 2
+
+static void
+lru_init(size_t frame_cnt UNUSED)
+{
+  lists_init();
+}
+
+static void
+lru_insert(struct frame_entry *e)
+{
+  e->policy_ref = false;
+  policy_move(e, LRU_INACTIVE);
+}
+
+/* Demotes active pages until a third of the pages are inactive */
+static void
+lru_balance(void)
+{
+  size_t scans = policy_list_cnt[LRU_ACTIVE];
+
+  while (scans-- > 0
+         && policy_list_cnt[LRU_INACTIVE] * 3
+            < policy_list_cnt[LRU_ACTIVE] + policy_list_cnt[LRU_INACTIVE])
+    {
+      struct frame_entry *e = policy_oldest(LRU_ACTIVE);
+
+      if (frame_evictable(e) && frame_test_and_clear_accessed(e))
+        policy_move(e, LRU_ACTIVE);
+      else
+        {
+          e->policy_ref = false;
+          policy_move(e, LRU_INACTIVE);
+        }
+    }
+}
+
+static struct frame_entry *
+lru_victim(void)
+{
+  size_t scans;
+
+  lru_balance();
+  scans = 2 * policy_list_cnt[LRU_INACTIVE];
+  while (scans-- > 0)
+    {
+      struct frame_entry *e = policy_oldest(LRU_INACTIVE);
+
+      if (!frame_evictable(e))
+        policy_move(e, LRU_INACTIVE);
+      else if (!frame_test_and_clear_accessed(e))
+        return e;
+      else if (!e->policy_ref)
+        {
+          e->policy_ref = true;
+          policy_move(e, LRU_INACTIVE);
+        }
+      else
+        policy_move(e, LRU_ACTIVE);
+    }
+  return any_evictable();
+}
+
+const struct frame_policy frame_policy_lru =
+  {"lru", lru_init, lru_insert, lists_remove, lru_victim, lists_requeue};
+
+/* ---------------------------------------------------------------- */
+/* 2Q with adaptive sizing.  New pages go on A1; pages seen
+   accessed twice there, as in lru, move to Am, which is managed as
+   a clock.  The
+   identities of pages evicted from each list are remembered in a
+   ghost ring, and a fault on a remembered page shifts the A1
+   target towards the list that would have kept it, as in ARC. */
+
+#define Q_A1 1
+#define Q_AM 2
+
+/* Identity of an evicted page */
+struct ghost
+{
+  tid_t tid;                /* Owner, TID_ERROR if slot is empty */
+  void *upage;              /* User virtual address */
+  struct list_elem elem;    /* Element in a bucket of the ring's index */
+};
+
+/* Fixed-size ring of ghosts, oldest overwritten first.  Live ghosts
+   are also chained into buckets by a hash of their owner and page,
+   so that every fault can look itself up in constant time. */
+struct ghost_ring
+{
+  struct ghost *slots;      /* Array of CAP slots */
+  size_t cap;               /* Number of slots */
+  size_t next;              /* Slot to overwrite next */
+  size_t cnt;               /* Number of live ghosts */
+  struct list *buckets;     /* Array of BUCKET_CNT lists of ghosts */
+  size_t bucket_cnt;        /* Power of 2, at least CAP */
+};
+
+static struct ghost_ring ghosts_a1;   /* Evicted from A1 */
+static struct ghost_ring ghosts_am;   /* Evicted from Am */
+static size_t a1_target;              /* Desired number of A1 pages */
+static size_t q_frame_cnt;
+
+static void
+ghost_init(struct ghost_ring *r, size_t cap)
+{
+  size_t i;
+
+  r->bucket_cnt = 1;
+  while (r->bucket_cnt < cap)
+    r->bucket_cnt *= 2;
+  r->slots = malloc(cap * sizeof *r->slots);
+  r->buckets = malloc(r->bucket_cnt * sizeof *r->buckets);
+  if (r->slots == NULL || r->buckets == NULL)
+    PANIC("cannot allocate 2Q ghost ring");
+  for (i = 0; i < cap; i++)
+    r->slots[i].tid = TID_ERROR;
+  for (i = 0; i < r->bucket_cnt; i++)
+    list_init(&r->buckets[i]);
+  r->cap = cap;
+  r->next = 0;
+  r->cnt = 0;
+}
+
+/* Returns the bucket of R's index for E's page */
+static struct list *
+ghost_bucket(struct ghost_ring *r, const struct frame_entry *e)
+{
+  unsigned h = hash_int(e->owner->tid) ^ hash_int(pg_no(e->upage));
+
+  return &r->buckets[h & (r->bucket_cnt - 1)];
+}
+
+/* Returns R's ghost of E's page, or NULL if R does not remember it */
+static struct ghost *
+ghost_find(struct ghost_ring *r, const struct frame_entry *e)
+{
+  struct list *bucket = ghost_bucket(r, e);
+  struct list_elem *le;
+
+  for (le = list_begin(bucket); le != list_end(bucket); le = list_next(le))
+    {
+      struct ghost *g = list_entry(le, struct ghost, elem);
+      if (g->tid == e->owner->tid && g->upage == e->upage)
+        return g;
+    }
+  return NULL;
+}
+
+/* Empties G's slot of R */
+static void
+ghost_forget(struct ghost_ring *r, struct ghost *g)
+{
+  list_remove(&g->elem);
+  g->tid = TID_ERROR;
+  r->cnt--;
+}
+
+/* Remembers E's page in R, in place of the oldest ghost if R is
+   full.  A page is remembered at most once. */
+static void
+ghost_add(struct ghost_ring *r, const struct frame_entry *e)
+{
+  struct ghost *g = ghost_find(r, e);
+
+  if (g != NULL)
+    ghost_forget(r, g);
+  g = &r->slots[r->next];
+  if (g->tid != TID_ERROR)
+    ghost_forget(r, g);
+  g->tid = e->owner->tid;
+  g->upage = e->upage;
+  list_push_back(ghost_bucket(r, e), &g->elem);
+  r->cnt++;
+  r->next = (r->next + 1) % r->cap;
+}
+
+/* Forgets E's page if R remembers it.  Returns true if it did. */
+static bool
+ghost_take(struct ghost_ring *r, const struct frame_entry *e)
+{
+  struct ghost *g = ghost_find(r, e);
+
+  if (g == NULL)
+    return false;
+  ghost_forget(r, g);
+  return true;
+}
+
+static void
+q_init(size_t frame_cnt)
+{
+  lists_init();
+  q_frame_cnt = frame_cnt;
+  a1_target = frame_cnt / 4;
+  ghost_init(&ghosts_a1, frame_cnt);
+  ghost_init(&ghosts_am, frame_cnt);
+}
+
+static void
+q_insert(struct frame_entry *e)
+{
+  size_t step;
+
+  e->policy_ref = false;
+  if (ghost_take(&ghosts_a1, e))
+    {
+      /* Evicted from A1 too soon: grow A1 */
+      step = ghosts_am.cnt > ghosts_a1.cnt + 1
+             ? ghosts_am.cnt / (ghosts_a1.cnt + 1) : 1;
+      a1_target = a1_target + step < q_frame_cnt
+                  ? a1_target + step : q_frame_cnt;
+      policy_move(e, Q_AM);
+    }
+  else if (ghost_take(&ghosts_am, e))
+    {
+      /* Evicted from Am too soon: shrink A1 */
+      step = ghosts_a1.cnt > ghosts_am.cnt + 1
+             ? ghosts_a1.cnt / (ghosts_am.cnt + 1) : 1;
+      a1_target = a1_target > step ? a1_target - step : 0;
+      policy_move(e, Q_AM);
+    }
+  else
+    policy_move(e, Q_A1);
+}
+
+/* Scans list WHICH for a page to evict, moving pages accessed
+   again to Am.  Returns NULL if none is found. */
+static struct frame_entry *
+q_scan(int which)
+{
+  size_t scans = policy_list_cnt[which];
+
+  while (scans-- > 0)
+    {
+      struct frame_entry *e = policy_oldest(which);
+
+      if (!frame_evictable(e))
+        policy_move(e, which);
+      else if (!frame_test_and_clear_accessed(e))
+        {
+          ghost_add(which == Q_A1 ? &ghosts_a1 : &ghosts_am, e);
+          return e;
+        }
+      else if (which == Q_A1 && !e->policy_ref)
+        {
+          e->policy_ref = true;
+          policy_move(e, Q_A1);
+        }
+      else
+        policy_move(e, Q_AM);
+    }
+  return NULL;
+}
+
+/* Keeps E on its list and forgets the ghost q_scan() left for it,
+   since it was not evicted after all */
+static void
+q_requeue(struct frame_entry *e)
+{
+  ghost_take(e->policy_list == Q_A1 ? &ghosts_a1 : &ghosts_am, e);
+  lists_requeue(e);
+}
+
+static struct frame_entry *
+q_victim(void)
+{
+  struct frame_entry *e = NULL;
+
+  if (policy_list_cnt[Q_A1] > 0
+      && (policy_list_cnt[Q_A1] > a1_target || policy_list_cnt[Q_AM] == 0))
+    e = q_scan(Q_A1);
+  if (e == NULL)
+    e = q_scan(Q_AM);
+  if (e == NULL)
+    e = q_scan(Q_A1);
+  return e != NULL ? e : any_evictable();
+}
+
+const struct frame_policy frame_policy_2q =
+  {"2q", q_init, q_insert, lists_remove, q_victim, q_requeue};
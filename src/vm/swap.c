@@ -1,9 +1,15 @@
 #include "vm/swap.h"
 #include <bitmap.h>
+#include <debug.h>
+#include <stdint.h>
 #include <stdio.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "devices/block.h"
+#include "vm/page.h"
+#include "vm/zswap.h"
 
 /* Number of sectors per page */
 #define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
@@ -11,6 +17,31 @@
 static struct block *swap_block;    /* Swap block device */
 static struct bitmap *swap_table;   /* Bitmap of swap slots */
 static struct lock swap_lock;       /* Lock for swap table */
+static size_t swap_cursor;          /* Where the next slot search starts */
+
+/* Swap cache.  A page keeps its slot after it is swapped in, for
+   as long as it stays clean, so that evicting it again needs no
+   write.  Such slots are taken back when swap runs out, so each
+   slot records the page table entry that refers to it. */
+struct swap_owner
+{
+  struct spt *spt;                  /* Page table holding ENTRY */
+  struct spt_entry *entry;          /* Entry whose page is in the slot */
+};
+static struct swap_owner *swap_owners;  /* Owner of each slot */
+
+/* Number of page table entries referring to each slot.  A page
+   swapped out while shared copy-on-write after fork() is written
+   once, and every process sharing it refers to the same slot. */
+static uint16_t *swap_refs;
+static long long swap_reclaimed;    /* # of cached slots given up */
+static long long swap_writes;       /* # of pages written to the device */
+static long long swap_reads;        /* # of pages read from the device */
+
+static size_t reclaim_cached(size_t cnt);
+static bool store_compressed(size_t slot, void *kpage);
+static void write_run(size_t first, void *kpages[], size_t cnt);
+static void read_run(size_t first, void *kpages[], size_t cnt);
 
 /* Initialize the swap table */
 void 
@@ -27,6 +58,11 @@ swap_init(void)
   swap_table = bitmap_create(swap_size);  
   if (swap_table != NULL)
     bitmap_set_all(swap_table, false);
+  swap_owners = calloc(swap_size, sizeof *swap_owners);
+  swap_refs = calloc(swap_size, sizeof *swap_refs);
+  if (swap_owners == NULL || swap_refs == NULL)
+    PANIC("Cannot allocate swap owner table");
+  zswap_init(swap_size);
   
   lock_init(&swap_lock);
 }
@@ -35,60 +71,279 @@ swap_init(void)
 size_t 
 swap_out(void *kpage)
 {
-  lock_acquire(&swap_lock);
-  
-  /* Find free swap slot */
-  size_t slot = bitmap_scan_and_flip(swap_table, 0, 1, false);
-  if (slot == BITMAP_ERROR){
-    lock_release(&swap_lock);
-    PANIC("Swap partition is full");
-  }
-  
-  /* Write page to swap (one page = 8 sectors) */
-  for (size_t i = 0; i < SECTORS_PER_PAGE; i++)
+  size_t slot;
+
+  swap_out_cluster(&kpage, 1, &slot);
+  return slot;
+}
+
+/* Allocate a run of up to CNT contiguous free slots, searching
+   next-fit from swap_cursor.  Stores the first slot in *SLOT and
+   returns the run's length.  Must be called with swap_lock held. */
+static size_t
+alloc_run(size_t cnt, size_t *slot)
+{
+  for (; cnt > 0; cnt /= 2)
     {
-      block_sector_t sector = slot * SECTORS_PER_PAGE + i;
-      block_write(swap_block, sector, kpage + i * BLOCK_SECTOR_SIZE);
+      *slot = bitmap_scan_and_flip(swap_table, swap_cursor, cnt, false);
+      if (*slot == BITMAP_ERROR && swap_cursor > 0)
+        *slot = bitmap_scan_and_flip(swap_table, 0, cnt, false);
+      if (*slot != BITMAP_ERROR)
+        {
+          size_t i;
+
+          for (i = 0; i < cnt; i++)
+            swap_refs[*slot + i] = 1;
+          swap_cursor = *slot + cnt;
+          if (swap_cursor >= bitmap_size(swap_table))
+            swap_cursor = 0;
+          return cnt;
+        }
     }
-  
-  lock_release(&swap_lock);
-  
-  return slot;
+  return 0;
+}
+
+/* Write the CNT pages in KPAGES to swap, storing the slot of
+   KPAGES[I] in SLOTS[I].  The pages go to consecutive slots where
+   space allows.  Pages the compressed tier takes are not written
+   to the device, and each run of the rest is written with a single
+   multi-sector operation. */
+void
+swap_out_cluster(void *kpages[], size_t cnt, size_t slots[])
+{
+  size_t done, run, first, start, i;
+
+  ASSERT(cnt <= SWAP_CLUSTER_MAX);
+
+  for (done = 0; done < cnt; done += run)
+    {
+      lock_acquire(&swap_lock);
+      run = alloc_run(cnt - done, &first);
+      if (run == 0 && reclaim_cached(cnt - done) > 0)
+        run = alloc_run(cnt - done, &first);
+      lock_release(&swap_lock);
+      if (run == 0)
+        PANIC("Swap partition is full");
+
+      /* The slots are ours, so other swap I/O can proceed
+         meanwhile. */
+      start = 0;
+      for (i = 0; i <= run; i++)
+        {
+          if (i < run)
+            slots[done + i] = first + i;
+          if (i == run || store_compressed(first + i, kpages[done + i]))
+            {
+              if (i > start)
+                write_run(first + start, kpages + done + start, i - start);
+              start = i + 1;
+            }
+        }
+    }
+}
+
+/* Offers KPAGE, bound for SLOT, to the compressed tier, writing
+   the tier's oldest pages back to the device if there is no room.
+   Returns true if the tier took the page. */
+static bool
+store_compressed(size_t slot, void *kpage)
+{
+  enum zswap_result result;
+  size_t tries;
+
+  result = zswap_store(slot, kpage);
+  for (tries = 0; result == ZSWAP_FULL && tries < SWAP_CLUSTER_MAX; tries++)
+    {
+      void *buf = palloc_get_page(0);
+      size_t old_slot;
+
+      if (buf == NULL)
+        break;
+      if (zswap_writeback_begin(&old_slot, buf))
+        {
+          write_run(old_slot, &buf, 1);
+          zswap_writeback_end(old_slot);
+        }
+      else
+        tries = SWAP_CLUSTER_MAX;
+      palloc_free_page(buf);
+      result = zswap_store(slot, kpage);
+    }
+  return result == ZSWAP_STORED;
+}
+
+/* Writes the CNT pages in KPAGES to slots FIRST onward with a
+   single multi-sector operation */
+static void
+write_run(size_t first, void *kpages[], size_t cnt)
+{
+  const void *sectors[SWAP_CLUSTER_MAX * SECTORS_PER_PAGE];
+  size_t i, j;
+
+  ASSERT(cnt <= SWAP_CLUSTER_MAX);
+
+  for (i = 0; i < cnt; i++)
+    for (j = 0; j < SECTORS_PER_PAGE; j++)
+      sectors[i * SECTORS_PER_PAGE + j]
+        = (uint8_t *) kpages[i] + j * BLOCK_SECTOR_SIZE;
+  block_write_multiple(swap_block, first * SECTORS_PER_PAGE,
+                       sectors, cnt * SECTORS_PER_PAGE);
+  swap_writes += cnt;
+}
+
+/* Reads slots FIRST onward into the CNT pages in KPAGES with a
+   single multi-sector operation */
+static void
+read_run(size_t first, void *kpages[], size_t cnt)
+{
+  void *sectors[SWAP_CLUSTER_MAX * SECTORS_PER_PAGE];
+  size_t i, j;
+
+  ASSERT(cnt <= SWAP_CLUSTER_MAX);
+
+  for (i = 0; i < cnt; i++)
+    for (j = 0; j < SECTORS_PER_PAGE; j++)
+      sectors[i * SECTORS_PER_PAGE + j]
+        = (uint8_t *) kpages[i] + j * BLOCK_SECTOR_SIZE;
+  block_read_multiple(swap_block, first * SECTORS_PER_PAGE,
+                      sectors, cnt * SECTORS_PER_PAGE);
+  swap_reads += cnt;
 }
 
 /* Read a page from swap */
 void 
 swap_in(size_t slot, void *kpage)
 {
-  lock_acquire(&swap_lock);
-  
-  /* Check if slot is in use */
-  if (!bitmap_test(swap_table, slot)){
-    lock_release(&swap_lock);
-    PANIC("Reading from free swap slot");
-  }
-  
-  /* Read page from swap (one page = 8 sectors) */
-  for (size_t i = 0; i < SECTORS_PER_PAGE; i++)
+  swap_read_cluster(slot, &kpage, 1);
+  swap_free(slot);
+}
+
+/* Read the CNT pages in slots FIRST through FIRST + CNT - 1 into
+   KPAGES.  Pages the compressed tier holds are decompressed, and
+   each run of the rest is read with a single multi-sector
+   operation.  The slots stay allocated until the caller frees
+   them. */
+void
+swap_read_cluster(size_t first, void *kpages[], size_t cnt)
+{
+  size_t start, i;
+
+  ASSERT(cnt <= SWAP_CLUSTER_MAX);
+
+  start = 0;
+  for (i = 0; i <= cnt; i++)
     {
-      block_sector_t sector = slot * SECTORS_PER_PAGE + i;
-      block_read(swap_block, sector, kpage + i * BLOCK_SECTOR_SIZE);
+      /* Check if slot is in use.  It stays allocated, and so is
+         not rewritten, until the caller frees it. */
+      if (i < cnt && !bitmap_test(swap_table, first + i))
+        PANIC("Reading from free swap slot");
+      if (i == cnt || zswap_load(first + i, kpages[i]))
+        {
+          if (i > start)
+            read_run(first + start, kpages + start, i - start);
+          start = i + 1;
+        }
     }
-  
-  /* Free the swap slot */
-  bitmap_set(swap_table, slot, false);
-  
-  lock_release(&swap_lock);
 }
 
-/* Free a swap slot */
+/* Free a swap slot, once every reference to it is gone */
 void 
 swap_free(size_t slot)
 {
+  bool last;
+
   lock_acquire(&swap_lock);
-  
-  if (bitmap_test(swap_table, slot))
-    bitmap_set(swap_table, slot, false);
-  
+  if (swap_refs[slot] == 0)
+    {
+      lock_release(&swap_lock);
+      return;
+    }
+  last = --swap_refs[slot] == 0;
+  swap_owners[slot].spt = NULL;
+  swap_owners[slot].entry = NULL;
   lock_release(&swap_lock);
+
+  /* The slot stays allocated until any writeback to it is over */
+  if (last)
+    {
+      zswap_invalidate(slot);
+      lock_acquire(&swap_lock);
+      bitmap_set(swap_table, slot, false);
+      lock_release(&swap_lock);
+    }
+}
+
+/* Add a reference to SLOT, for another page table entry that
+   refers to the same page */
+void
+swap_dup(size_t slot)
+{
+  lock_acquire(&swap_lock);
+  ASSERT(swap_refs[slot] > 0);
+  swap_refs[slot]++;
+  lock_release(&swap_lock);
+}
+
+/* Record that SLOT holds the page of ENTRY in SPT, so that the
+   slot can be taken back from the entry if the page is resident
+   when swap runs out.  SPT's lock must be held. */
+void
+swap_set_owner(size_t slot, struct spt *spt, struct spt_entry *entry)
+{
+  lock_acquire(&swap_lock);
+  swap_owners[slot].spt = spt;
+  swap_owners[slot].entry = entry;
+  lock_release(&swap_lock);
+}
+
+/* Give up the slots of up to CNT resident, clean pages that no
+   other page refers to, the only slots that do not hold a page's
+   only copy.  Returns the number
+   freed.  Must be called with swap_lock held.
+
+   Page table locks are taken after swap_lock here but before it
+   elsewhere, so they are only tried, and pages whose table is in
+   use are skipped.  An entry cannot be freed meanwhile, since
+   swap_free() must take swap_lock first. */
+static size_t
+reclaim_cached(size_t cnt)
+{
+  size_t slot, freed = 0;
+
+  for (slot = 0; slot < bitmap_size(swap_table) && freed < cnt; slot++)
+    {
+      struct swap_owner *o = &swap_owners[slot];
+
+      if (o->entry == NULL || !rwlock_try_acquire_write(&o->spt->lock))
+        continue;
+      if (o->entry->loaded && !o->entry->in_transit
+          && o->entry->swap_slot == slot && swap_refs[slot] == 1
+          && zswap_try_invalidate(slot))
+        {
+          o->entry->swap_slot = SWAP_SLOT_NONE;
+          swap_refs[slot] = 0;
+          bitmap_set(swap_table, slot, false);
+          rwlock_release_write(&o->spt->lock);
+          o->spt = NULL;
+          o->entry = NULL;
+          swap_reclaimed++;
+          freed++;
+        }
+      else
+        rwlock_release_write(&o->spt->lock);
+    }
+  return freed;
+}
+
+/* Print swap statistics */
+void
+swap_print_stats(void)
+{
+  if (swap_table != NULL)
+    printf("Swap: %zu of %zu slots in use, %lld pages written, "
+           "%lld read, %lld cached slots reclaimed\n",
+           bitmap_count(swap_table, 0, bitmap_size(swap_table), true),
+           bitmap_size(swap_table), swap_writes, swap_reads,
+           swap_reclaimed);
+  zswap_print_stats();
 }
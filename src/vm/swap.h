@@ -1,18 +1,43 @@
 #ifndef VM_SWAP_H
 #define VM_SWAP_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
+struct spt;
+struct spt_entry;
+
+/* Swap slot of a page that has none */
+#define SWAP_SLOT_NONE ((size_t) -1)
+
 /* Initialize the swap table */
 void swap_init(void);
 
 /* Write a page to swap, returns swap slot index */
 size_t swap_out(void *kpage);
 
+/* Most pages swap_out_cluster() writes at once */
+#define SWAP_CLUSTER_MAX 16
+
+/* Write several pages to swap, in adjacent slots where possible */
+void swap_out_cluster(void *kpages[], size_t cnt, size_t slots[]);
+
 /* Read a page from swap */
 void swap_in(size_t slot, void *kpage);
 
+/* Read pages from consecutive slots, without freeing the slots */
+void swap_read_cluster(size_t first, void *kpages[], size_t cnt);
+
 /* Free a swap slot */
 void swap_free(size_t slot);
 
+/* Add a reference to a swap slot */
+void swap_dup(size_t slot);
+
+/* Record which page a swap slot holds */
+void swap_set_owner(size_t slot, struct spt *spt, struct spt_entry *entry);
+
+/* Print swap statistics */
+void swap_print_stats(void);
+
 #endif /* vm/swap.h */
@@ -0,0 +1,162 @@
+#include "vm/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Records per sector. */
+#define RECORDS_PER_SECTOR \
+        (BLOCK_SECTOR_SIZE / sizeof (struct vmtrace_record))
+
+/* Records are buffered in memory, since they are produced with
+   interrupts off, and written out a sector at a time by
+   vmtrace_flush().  The buffer is a ring of BUF_RECORDS. */
+#define BUF_RECORDS (RECORDS_PER_SECTOR * 32)
+
+bool vmtrace_enabled;
+
+static struct block *trace_block;       /* Scratch device. */
+static struct vmtrace_record *buf;      /* Ring buffer. */
+static size_t buf_head;                 /* Oldest buffered record. */
+static size_t buf_cnt;                  /* # of buffered records. */
+static struct lock trace_lock;          /* Serializes flushes. */
+static block_sector_t next_sector;      /* Next sector for records. */
+static struct vmtrace_header header;    /* Header, kept up to date. */
+static bool trace_full;                 /* Scratch device is full. */
+
+static void write_header(void);
+
+/* Prepares to trace onto the scratch device, if tracing is
+   enabled.  FRAME_CNT and POLICY are recorded in the header. */
+void
+vmtrace_init(size_t frame_cnt, const char *policy)
+{
+  if (!vmtrace_enabled)
+    return;
+
+  trace_block = block_get_role(BLOCK_SCRATCH);
+  buf = malloc(BUF_RECORDS * sizeof *buf);
+  if (trace_block == NULL || buf == NULL)
+    {
+      printf("vmtrace: no scratch device, tracing disabled\n");
+      free(buf);
+      vmtrace_enabled = false;
+      return;
+    }
+
+  lock_init(&trace_lock);
+  memcpy(header.magic, VMTRACE_MAGIC, sizeof header.magic);
+  header.frame_cnt = frame_cnt;
+  strlcpy(header.policy, policy, sizeof header.policy);
+  next_sector = 1;
+}
+
+/* Appends a record of TYPE for TID's page UPAGE to the buffer,
+   with the dirty flag if DIRTY.  Drops the record if the buffer
+   is full.  May be called with interrupts off. */
+void
+vmtrace_record(int type, int tid, void *upage, bool dirty)
+{
+  enum intr_level old_level;
+  struct vmtrace_record *r;
+
+  if (!vmtrace_enabled)
+    return;
+
+  old_level = intr_disable();
+  if (buf_cnt < BUF_RECORDS && !trace_full)
+    {
+      r = &buf[(buf_head + buf_cnt++) % BUF_RECORDS];
+      r->tid = tid;
+      r->page = (uint32_t) pg_round_down(upage) | type
+                | (dirty ? VMTRACE_DIRTY : 0);
+    }
+  else
+    header.dropped_cnt++;
+  intr_set_level(old_level);
+}
+
+/* Writes every full sector of buffered records to the scratch
+   device, and then the header.  If PARTIAL, also writes the
+   records of a final partial sector; they stay buffered, so the
+   sector is rewritten once it fills up.  Must be called in a
+   context that can sleep. */
+void
+vmtrace_flush(bool partial)
+{
+  static struct vmtrace_record sector[RECORDS_PER_SECTOR];
+  bool wrote = false;
+
+  if (!vmtrace_enabled || (buf_cnt < RECORDS_PER_SECTOR && !partial))
+    return;
+
+  lock_acquire(&trace_lock);
+  while (!trace_full)
+    {
+      enum intr_level old_level;
+      size_t i, n;
+
+      if (next_sector >= block_size(trace_block))
+        {
+          trace_full = true;
+          break;
+        }
+
+      /* Copy out one sector's worth with interrupts off. */
+      old_level = intr_disable();
+      n = buf_cnt < RECORDS_PER_SECTOR ? buf_cnt : RECORDS_PER_SECTOR;
+      if (n < RECORDS_PER_SECTOR && (!partial || n == 0))
+        {
+          intr_set_level(old_level);
+          break;
+        }
+      memset(sector, 0, sizeof sector);
+      for (i = 0; i < n; i++)
+        sector[i] = buf[(buf_head + i) % BUF_RECORDS];
+      if (n == RECORDS_PER_SECTOR)
+        {
+          buf_head = (buf_head + n) % BUF_RECORDS;
+          buf_cnt -= n;
+        }
+      intr_set_level(old_level);
+
+      block_write(trace_block, next_sector, sector);
+      wrote = true;
+      if (n < RECORDS_PER_SECTOR)
+        {
+          header.record_cnt = (next_sector - 1) * RECORDS_PER_SECTOR + n;
+          break;
+        }
+      next_sector++;
+      header.record_cnt = (next_sector - 1) * RECORDS_PER_SECTOR;
+    }
+  if (wrote)
+    write_header();
+  lock_release(&trace_lock);
+}
+
+/* Prints tracing statistics. */
+void
+vmtrace_print_stats(void)
+{
+  if (vmtrace_enabled)
+    printf("vmtrace: %"PRIu32" records on %s, %"PRIu32" dropped\n",
+            header.record_cnt, block_name(trace_block),
+            header.dropped_cnt);
+}
+
+/* Writes the header to sector 0 of the scratch device. */
+static void
+write_header(void)
+{
+  static uint8_t sector[BLOCK_SECTOR_SIZE];
+
+  memset(sector, 0, sizeof sector);
+  memcpy(sector, &header, sizeof header);
+  block_write(trace_block, 0, sector);
+}
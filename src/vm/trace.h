@@ -0,0 +1,47 @@
+#ifndef VM_TRACE_H
+#define VM_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Page reference trace, written to the scratch disk for offline
+   replay by utils/vmsim.
+
+   Sector 0 holds a header; the following sectors hold an array
+   of records.  The format is shared with utils/vmsim.c, so any
+   change here must be made there too. */
+#define VMTRACE_MAGIC "PINTOS-VMTRACE1"
+
+/* Trace header, padded to one sector. */
+struct vmtrace_header
+{
+  char magic[16];             /* VMTRACE_MAGIC. */
+  uint32_t frame_cnt;         /* # of user frames in the machine. */
+  uint32_t record_cnt;        /* # of records that follow. */
+  uint32_t dropped_cnt;       /* # of records lost to overflow. */
+  char policy[16];            /* Replacement policy in use. */
+};
+
+/* Record types, in the low bits of a record's PAGE. */
+#define VMTRACE_FAULT 1         /* Page was faulted in. */
+#define VMTRACE_REF 2           /* Resident page seen accessed. */
+#define VMTRACE_DIRTY 4         /* Page was also seen dirty. */
+
+/* One trace record. */
+struct vmtrace_record
+{
+  uint32_t tid;               /* Thread that owns the page. */
+  uint32_t page;              /* User page | type | flags. */
+};
+
+/* If true, record a page reference trace.
+   Controlled by kernel command-line option "-vmtrace". */
+extern bool vmtrace_enabled;
+
+void vmtrace_init(size_t frame_cnt, const char *policy);
+void vmtrace_record(int type, int tid, void *upage, bool dirty);
+void vmtrace_flush(bool partial);
+void vmtrace_print_stats(void);
+
+#endif /* vm/trace.h */
@@ -0,0 +1,396 @@
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* The pool is carved into ZSWAP_BLOCK-byte blocks, and each page
+   takes a run of them.  Pages that do not shrink to ZSWAP_MAX_LEN
+   bytes are not worth keeping and go straight to the swap device. */
+#define ZSWAP_BLOCK 64
+#define ZSWAP_MAX_LEN (PGSIZE * 3 / 4)
+
+/* Compressed copy of the page in one swap slot */
+struct zswap_entry
+{
+  uint32_t block;               /* First pool block */
+  uint16_t len;                 /* Compressed length in bytes */
+  bool stored;                  /* Pool holds the page */
+  bool writeback;               /* Page is being written to its slot */
+  struct list_elem lru_elem;    /* Element in lru, if stored */
+};
+
+size_t zswap_pool_pages;
+
+static uint8_t *pool;               /* Pool, NULL if the tier is off */
+static struct bitmap *pool_map;     /* Blocks in use */
+static struct zswap_entry *entries; /* Entry for every swap slot */
+static struct list lru;             /* Stored entries, oldest first */
+static struct lock zswap_lock;      /* Protects all of the above */
+static struct condition writeback_done; /* A writeback finished */
+
+/* Statistics */
+static long long zswap_stores;      /* # of pages stored */
+static long long zswap_rejects;     /* # of pages that did not compress */
+static long long zswap_loads;       /* # of pages read from the pool */
+static long long zswap_writebacks;  /* # of pages written back */
+static unsigned long long zswap_bytes;  /* Compressed size of stores */
+
+static size_t compress(const uint8_t *src, uint8_t *dst, size_t cap);
+static void decompress(const uint8_t *src, size_t len, uint8_t *dst);
+static void drop(struct zswap_entry *);
+
+/* Set up the pool for SLOT_CNT swap slots */
+void
+zswap_init(size_t slot_cnt)
+{
+  if (zswap_pool_pages == 0)
+    return;
+
+  pool = palloc_get_multiple(0, zswap_pool_pages);
+  pool_map = bitmap_create(zswap_pool_pages * (PGSIZE / ZSWAP_BLOCK));
+  entries = calloc(slot_cnt, sizeof *entries);
+  if (pool == NULL || pool_map == NULL || entries == NULL)
+    PANIC("Cannot allocate %zu-page compressed swap pool", zswap_pool_pages);
+
+  list_init(&lru);
+  lock_init(&zswap_lock);
+  cond_init(&writeback_done);
+}
+
+/* Offer page KPAGE, bound for swap SLOT, to the pool.  Returns
+   ZSWAP_STORED if the pool keeps it, in which case it need not be
+   written to the slot. */
+enum zswap_result
+zswap_store(size_t slot, const void *kpage)
+{
+  static uint8_t buf[ZSWAP_MAX_LEN];
+  struct zswap_entry *e = &entries[slot];
+  size_t len, block;
+
+  if (pool == NULL)
+    return ZSWAP_REJECTED;
+
+  lock_acquire(&zswap_lock);
+  ASSERT(!e->stored && !e->writeback);
+  len = compress(kpage, buf, sizeof buf);
+  if (len == 0)
+    {
+      zswap_rejects++;
+      lock_release(&zswap_lock);
+      return ZSWAP_REJECTED;
+    }
+  block = bitmap_scan_and_flip(pool_map, 0, DIV_ROUND_UP(len, ZSWAP_BLOCK),
+                               false);
+  if (block == BITMAP_ERROR)
+    {
+      lock_release(&zswap_lock);
+      return ZSWAP_FULL;
+    }
+
+  memcpy(pool + block * ZSWAP_BLOCK, buf, len);
+  e->block = block;
+  e->len = len;
+  e->stored = true;
+  list_push_back(&lru, &e->lru_elem);
+  zswap_stores++;
+  zswap_bytes += len;
+  lock_release(&zswap_lock);
+  return ZSWAP_STORED;
+}
+
+/* Reads the page in SLOT into KPAGE and returns true if the pool
+   holds it.  The pool keeps its copy until the slot is freed. */
+bool
+zswap_load(size_t slot, void *kpage)
+{
+  struct zswap_entry *e = &entries[slot];
+  bool found;
+
+  if (pool == NULL)
+    return false;
+
+  /* A page on its way to the slot must be read from there */
+  lock_acquire(&zswap_lock);
+  while (e->writeback)
+    cond_wait(&writeback_done, &zswap_lock);
+  found = e->stored;
+  if (found)
+    {
+      decompress(pool + e->block * ZSWAP_BLOCK, e->len, kpage);
+      zswap_loads++;
+    }
+  lock_release(&zswap_lock);
+  return found;
+}
+
+/* Drops the pool's copy of SLOT, which is being freed, waiting
+   first for any writeback to the slot to finish */
+void
+zswap_invalidate(size_t slot)
+{
+  struct zswap_entry *e = &entries[slot];
+
+  if (pool == NULL)
+    return;
+
+  lock_acquire(&zswap_lock);
+  while (e->writeback)
+    cond_wait(&writeback_done, &zswap_lock);
+  if (e->stored)
+    drop(e);
+  lock_release(&zswap_lock);
+}
+
+/* Like zswap_invalidate(), but returns false instead of waiting if
+   SLOT is being written back */
+bool
+zswap_try_invalidate(size_t slot)
+{
+  struct zswap_entry *e = &entries[slot];
+  bool success;
+
+  if (pool == NULL)
+    return true;
+
+  lock_acquire(&zswap_lock);
+  success = !e->writeback;
+  if (success && e->stored)
+    drop(e);
+  lock_release(&zswap_lock);
+  return success;
+}
+
+/* Takes the oldest page out of the pool to make room, storing its
+   slot in *SLOT and its contents in KPAGE.  The caller must write
+   KPAGE to the slot and then call zswap_writeback_end(); meanwhile
+   loads of the slot wait.  Returns false if the pool is empty. */
+bool
+zswap_writeback_begin(size_t *slot, void *kpage)
+{
+  struct zswap_entry *e;
+
+  if (pool == NULL)
+    return false;
+
+  lock_acquire(&zswap_lock);
+  if (list_empty(&lru))
+    {
+      lock_release(&zswap_lock);
+      return false;
+    }
+  e = list_entry(list_front(&lru), struct zswap_entry, lru_elem);
+  decompress(pool + e->block * ZSWAP_BLOCK, e->len, kpage);
+  drop(e);
+  e->writeback = true;
+  *slot = e - entries;
+  zswap_writebacks++;
+  lock_release(&zswap_lock);
+  return true;
+}
+
+/* Finishes writing back SLOT */
+void
+zswap_writeback_end(size_t slot)
+{
+  lock_acquire(&zswap_lock);
+  entries[slot].writeback = false;
+  cond_broadcast(&writeback_done, &zswap_lock);
+  lock_release(&zswap_lock);
+}
+
+/* Print pool statistics */
+void
+zswap_print_stats(void)
+{
+  if (pool == NULL)
+    return;
+  printf("Zswap: %zu-page pool, %lld stores at %llu%% of page size, "
+         "%lld loads, %lld incompressible, %lld written back\n",
+         zswap_pool_pages, zswap_stores,
+         zswap_stores > 0 ? zswap_bytes * 100 / (zswap_stores * PGSIZE) : 0,
+         zswap_loads, zswap_rejects, zswap_writebacks);
+}
+
+/* Frees E's blocks.  zswap_lock must be held. */
+static void
+drop(struct zswap_entry *e)
+{
+  bitmap_set_multiple(pool_map, e->block, DIV_ROUND_UP(e->len, ZSWAP_BLOCK),
+                      false);
+  list_remove(&e->lru_elem);
+  e->stored = false;
+}
+
+/* ---------------------------------------------------------------- */
+/* A small LZ77 compressor, in the format of LZ4.  The output is a
+   series of sequences, each a token byte, a run of literal bytes,
+   and a back-reference of at least MIN_MATCH bytes given as a
+   2-byte offset.  The token's high nibble is the literal count and
+   its low nibble the match length less MIN_MATCH; a nibble of 15
+   is extended by following bytes, up to a byte less than 255.  The
+   last sequence has literals only.  Matches are found through a
+   hash table of recent 4-byte strings. */
+
+#define MIN_MATCH 4
+#define HASH_BITS 10
+
+static uint16_t hash_table[1 << HASH_BITS];  /* Position + 1, or 0 */
+
+static uint32_t
+read32(const uint8_t *p)
+{
+  uint32_t v;
+
+  memcpy(&v, p, sizeof v);
+  return v;
+}
+
+static size_t
+hash32(uint32_t v)
+{
+  return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+/* Appends the extension bytes of length LEN to *OP */
+static bool
+put_len(uint8_t **op, const uint8_t *end, size_t len)
+{
+  for (; len >= 255; len -= 255)
+    {
+      if (*op >= end)
+        return false;
+      *(*op)++ = 255;
+    }
+  if (*op >= end)
+    return false;
+  *(*op)++ = len;
+  return true;
+}
+
+/* Appends a sequence of LIT_CNT literals from LIT followed by a
+   MATCH_LEN-byte match at OFFSET, or no match if MATCH_LEN is 0.
+   Returns false if it does not fit before END. */
+static bool
+emit(uint8_t **op, const uint8_t *end, const uint8_t *lit, size_t lit_cnt,
+     size_t offset, size_t match_len)
+{
+  size_t m = match_len > 0 ? match_len - MIN_MATCH : 0;
+  uint8_t *token = *op;
+
+  if (*op >= end)
+    return false;
+  (*op)++;
+  *token = (lit_cnt < 15 ? lit_cnt : 15) << 4 | (m < 15 ? m : 15);
+  if (lit_cnt >= 15 && !put_len(op, end, lit_cnt - 15))
+    return false;
+  if ((size_t) (end - *op) < lit_cnt)
+    return false;
+  memcpy(*op, lit, lit_cnt);
+  *op += lit_cnt;
+
+  if (match_len == 0)
+    return true;
+  if (end - *op < 2)
+    return false;
+  *(*op)++ = offset & 0xff;
+  *(*op)++ = offset >> 8;
+  return m < 15 || put_len(op, end, m - 15);
+}
+
+/* Compresses the page at SRC into DST, which has room for CAP
+   bytes.  Returns the compressed length, or 0 if it exceeds CAP.
+   zswap_lock must be held, for the hash table. */
+static size_t
+compress(const uint8_t *src, uint8_t *dst, size_t cap)
+{
+  const uint8_t *end = dst + cap;
+  uint8_t *op = dst;
+  size_t ip = 0, anchor = 0;
+
+  memset(hash_table, 0, sizeof hash_table);
+  while (ip + MIN_MATCH <= PGSIZE)
+    {
+      uint32_t v = read32(src + ip);
+      size_t h = hash32(v);
+      size_t ref = hash_table[h];
+
+      hash_table[h] = ip + 1;
+      if (ref != 0 && read32(src + ref - 1) == v)
+        {
+          size_t len = MIN_MATCH;
+
+          ref--;
+          while (ip + len < PGSIZE && src[ref + len] == src[ip + len])
+            len++;
+          if (!emit(&op, end, src + anchor, ip - anchor, ip - ref, len))
+            return 0;
+          ip += len;
+          anchor = ip;
+        }
+      else
+        ip++;
+    }
+  if (!emit(&op, end, src + anchor, PGSIZE - anchor, 0, 0))
+    return 0;
+  return op - dst;
+}
+
+/* Reads the extension bytes of a length from *IP */
+static size_t
+get_len(const uint8_t **ip)
+{
+  size_t len = 0;
+  uint8_t b;
+
+  do
+    {
+      b = *(*ip)++;
+      len += b;
+    }
+  while (b == 255);
+  return len;
+}
+
+/* Decompresses the LEN bytes at SRC into the page at DST */
+static void
+decompress(const uint8_t *src, size_t len, uint8_t *dst)
+{
+  const uint8_t *ip = src, *iend = src + len;
+  uint8_t *op = dst, *oend = dst + PGSIZE;
+
+  for (;;)
+    {
+      uint8_t token = *ip++;
+      size_t lit_cnt = token >> 4, match_len = token & 15, offset;
+
+      if (lit_cnt == 15)
+        lit_cnt += get_len(&ip);
+      ASSERT(lit_cnt <= (size_t) (oend - op));
+      memcpy(op, ip, lit_cnt);
+      ip += lit_cnt;
+      op += lit_cnt;
+      if (ip >= iend)
+        break;
+
+      offset = ip[0] | ip[1] << 8;
+      ip += 2;
+      if (match_len == 15)
+        match_len += get_len(&ip);
+      match_len += MIN_MATCH;
+      ASSERT(offset > 0 && offset <= (size_t) (op - dst));
+      ASSERT(match_len <= (size_t) (oend - op));
+
+      /* Byte by byte, since the match may overlap its own output */
+      for (; match_len > 0; match_len--, op++)
+        *op = op[-offset];
+    }
+  ASSERT(op == oend);
+}
@@ -0,0 +1,46 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Compressed swap tier.  Pages written to swap are first offered
+   to a pool of kernel pages that holds them compressed, keyed by
+   the swap slot they were given, and only go to the swap device
+   if they do not compress well or the pool is full.  The oldest
+   pages in the pool are written back to their slots to make room
+   for new ones. */
+
+/* Number of kernel pages in the pool, 0 to disable the tier.
+   Controlled by kernel command-line option "-zswap=PAGES". */
+extern size_t zswap_pool_pages;
+
+/* Result of offering a page to the pool */
+enum zswap_result
+{
+  ZSWAP_STORED,         /* Page is held in the pool */
+  ZSWAP_REJECTED,       /* Page does not compress well enough */
+  ZSWAP_FULL            /* No room in the pool */
+};
+
+/* Set up the pool for SLOT_CNT swap slots */
+void zswap_init(size_t slot_cnt);
+
+/* Offer page KPAGE, bound for swap SLOT, to the pool */
+enum zswap_result zswap_store(size_t slot, const void *kpage);
+
+/* Read the page in SLOT into KPAGE if the pool holds it */
+bool zswap_load(size_t slot, void *kpage);
+
+/* Drop the pool's copy of SLOT, if any */
+void zswap_invalidate(size_t slot);
+bool zswap_try_invalidate(size_t slot);
+
+/* Write back the pool's oldest page, in two steps */
+bool zswap_writeback_begin(size_t *slot, void *kpage);
+void zswap_writeback_end(size_t slot);
+
+/* Print pool statistics */
+void zswap_print_stats(void);
+
+#endif /* vm/zswap.h */